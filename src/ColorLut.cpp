@@ -0,0 +1,71 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <math.h>
+#include "ColorLut.h"
+
+ColorLut::ColorLut() : _phases(1) {
+  build(280, 255, 255, 255, 255, false);
+}
+
+void ColorLut::build(uint16_t gamma, uint8_t brightness, uint8_t gain_r, uint8_t gain_g, uint8_t gain_b, bool dither){
+  const uint8_t gains[3] = { gain_g, gain_r, gain_b };   // wire order
+  float exponent = gamma / 100.0f;
+
+  _phases = dither ? LUT_DITHER_PHASES : 1;
+  for(uint8_t c = 0; c < 3; c++){
+    float scale = 255.0f * brightness / 255.0f * gains[c] / 255.0f;
+    for(uint16_t v = 0; v < 256; v++){
+      float out = powf(v / 255.0f, exponent) * scale;
+      for(uint8_t p = 0; p < _phases; p++){
+        //rounding offsets spread evenly over the phases, 0.5 without dithering
+        int n = (int)(out + (p + 0.5f) / _phases);
+        _table[p][c][v] = n > 255 ? 255 : n;
+      }
+    }
+  }
+}
+
+void ColorLut::apply(uint8_t* row, uint16_t width, uint8_t phase) const{
+  const uint8_t* tg = _table[phase % _phases][0];
+  const uint8_t* tr = _table[phase % _phases][1];
+  const uint8_t* tb = _table[phase % _phases][2];
+
+  for(uint16_t i = 0; i < width; i++, row += 3){
+    row[0] = tg[row[0]];
+    row[1] = tr[row[1]];
+    row[2] = tb[row[2]];
+  }
+}
+
+void ColorLut::blend(uint8_t* dst, const uint8_t* a, const uint8_t* b, uint16_t width, uint16_t weight, uint8_t phase) const{
+  const uint8_t* tg = _table[phase % _phases][0];
+  const uint8_t* tr = _table[phase % _phases][1];
+  const uint8_t* tb = _table[phase % _phases][2];
+  uint16_t keep = 256 - weight;
+
+  //8.8 fixed point, the result never exceeds 255 since the weights add up to 256
+  for(uint16_t i = 0; i < width; i++, dst += 3, a += 3, b += 3){
+    dst[0] = tg[(a[0] * keep + b[0] * weight) >> 8];
+    dst[1] = tr[(a[1] * keep + b[1] * weight) >> 8];
+    dst[2] = tb[(a[2] * keep + b[2] * weight) >> 8];
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef COLOR_LUT_H
+#define COLOR_LUT_H
+
+#include <stdint.h>
+
+#define LUT_DITHER_PHASES 4     // rows cycle through this many rounding offsets when dithering
+
+// Per channel 256 entry tables which combine gamma, brightness and white
+// balance, so a row needs one lookup per byte. They are rebuilt only when
+// the configuration changes. With dithering there is one set of tables per
+// phase with different rounding, successive rows use successive phases so
+// the average brightness keeps the fractional part.
+class ColorLut {
+  public:
+    ColorLut();
+
+    // gamma x100 (e.g. 280), brightness and gains 0..255
+    void build(uint16_t gamma, uint8_t brightness, uint8_t gain_r, uint8_t gain_g, uint8_t gain_b, bool dither);
+
+    uint8_t phases() const { return _phases; }
+
+    // applies the tables in place to a row in GRB wire order
+    void apply(uint8_t* row, uint16_t width, uint8_t phase) const;
+
+    // dst = table[(a * (256 - weight) + b * weight) / 256], blends two linear
+    // rows and applies the tables in the same pass. weight 0..256
+    void blend(uint8_t* dst, const uint8_t* a, const uint8_t* b, uint16_t width, uint16_t weight, uint8_t phase) const;
+
+  private:
+    uint8_t _table[LUT_DITHER_PHASES][3][256];   // [phase][G, R, B][value]
+    uint8_t _phases;
+};
+
+#endif
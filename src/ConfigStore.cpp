@@ -0,0 +1,101 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <FS.h>
+#include "ConfigStore.h"
+
+#define SNAPSHOT_MAGIC 0x46434C4C    // "LLCF"
+#define SNAPSHOT_TMP "/snapshot.tmp"
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  uint32_t crc;
+};
+
+static bool readFile(const char* path, uint16_t version, void* data, size_t size){
+  SnapshotHeader header;
+  uint8_t buf[64];
+  uint32_t crc = 0;
+  size_t left, n;
+
+  File file = SPIFFS.open(path, "r");
+  if(!file)
+    return false;
+  if(file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != SNAPSHOT_MAGIC ||
+     header.version != version || header.size != size || file.size() != sizeof(header) + size){
+    file.close();
+    return false;
+  }
+  //check the CRC before data is touched, a broken snapshot keeps the defaults
+  for(left = size; left > 0; left -= n){
+    n = left < sizeof(buf) ? left : sizeof(buf);
+    if(file.read(buf, n) != n)
+      break;
+    crc = crc32(buf, n, crc);
+  }
+  if(left != 0 || crc != header.crc || !file.seek(sizeof(header), SeekSet) ||
+     file.read((uint8_t*)data, size) != size){
+    file.close();
+    return false;
+  }
+  file.close();
+  return true;
+}
+
+bool readSnapshot(const char* path, uint16_t version, void* data, size_t size){
+  //a complete temporary file is newer than path: the power went off between
+  //writing it and the rename, which is done now
+  if(SPIFFS.exists(SNAPSHOT_TMP)){
+    if(readFile(SNAPSHOT_TMP, version, data, size)){
+      SPIFFS.remove(path);
+      SPIFFS.rename(SNAPSHOT_TMP, path);
+      return true;
+    }
+    SPIFFS.remove(SNAPSHOT_TMP);
+  }
+  return readFile(path, version, data, size);
+}
+
+bool writeSnapshot(const char* path, uint16_t version, const void* data, size_t size){
+  SnapshotHeader header;
+  bool ok;
+
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = version;
+  header.size = size;
+  header.crc = crc32(data, size);
+
+  File file = SPIFFS.open(SNAPSHOT_TMP, "w");
+  if(!file)
+    return false;
+  ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+       file.write((const uint8_t*)data, size) == size;
+  file.close();
+  if(ok){
+    SPIFFS.remove(path);    // SPIFFS doesn't rename onto an existing file
+    ok = SPIFFS.rename(SNAPSHOT_TMP, path);
+  }
+  if(!ok)
+    SPIFFS.remove(SNAPSHOT_TMP);
+  return ok;
+}
@@ -0,0 +1,18 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "Crc32.h"
+
+// A struct stored as is on SPIFFS, behind a header with magic, version,
+// size and CRC32. Bump the version whenever the layout of the struct
+// changes, an old snapshot is then ignored.
+
+// fills data only if the snapshot is complete and unchanged, false otherwise
+bool readSnapshot(const char* path, uint16_t version, void* data, size_t size);
+// written to a temporary file first, which replaces the old snapshot once it
+// is complete. After a power cut in between readSnapshot() takes the
+// temporary file, so either the old or the new snapshot is read
+bool writeSnapshot(const char* path, uint16_t version, const void* data, size_t size);
+
+#endif
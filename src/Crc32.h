@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 as used by zip and zlib. Pass the result of the previous call as
+// crc to checksum data in pieces.
+uint32_t crc32(const void* data, size_t len, uint32_t crc = 0);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include "DrawEngine.h"
+#include "ImageStore.h"
+#include "Metrics.h"
+
+static uint32_t streamClock(){
+  return micros();
+}
+
+DrawEngine::DrawEngine(LineScheduler& scheduler, const ColorLut& lut)
+  : _scheduler(scheduler), _pipeline(scheduler, lut), _output(NULL), _fileSrc(_file), _pattern(NULL),
+    _source(NULL), _pattern_rows(0), _resample(RESAMPLE_BOX), _stream(lut, streamClock), _state(DRAW_IDLE), _pin(0),
+    _output_type(OUTPUT_NEOPIXEL), _leds(0),
+    _line_us(0), _countdown_ms(0), _countdown_start(0), _cached(false) {
+  _filename[0] = 0;
+}
+
+bool DrawEngine::start(const char *filename, uint16_t leds, uint8_t pin, OutputType output, uint32_t line_us, uint32_t countdown_ms){
+  size_t cached_len;
+
+  if(busy()){
+    Serial.println(F("Already drawing"));
+    return false;
+  }
+  release();
+  strncpy(_filename, filename, sizeof(_filename) - 1);
+  _filename[sizeof(_filename) - 1] = 0;
+
+  SPIFFS.begin();
+  // Repeated shots come from RAM, everything else is streamed from SPIFFS
+  const uint8_t * data = cacheImage(_filename, &cached_len);
+  uint32_t header_start = metrics.start();
+  _cached = data != NULL;
+  if(_cached){
+    _mem.set(data, cached_len);
+    _img.open(&_mem);
+    imageCache.pin(_filename);
+  }
+  else if(openImageFile(_filename, _file, _img, _fileSrc) < 0){
+    return false;
+  }
+  metrics.record(METRIC_HEADER, header_start);
+
+  Serial.println(_img.width());
+  Serial.println(_img.rows());
+
+  //read ahead while the current row is on the strip. Cached images need no
+  //read ahead, a row is just a memcpy, so they go straight into the pixel buffer
+  if(!begin(&_img, _cached ? 0 : ROW_RING_SLOTS, leds, pin, output, line_us, countdown_ms)){
+    //only an image wider than the strip is refused, it can't be scaled down
+    if(_resample == RESAMPLE_OFF)
+      Serial.println(F("Error Image is wider than the strip and scaling is off"));
+    else
+      Serial.println(F("Error no memory to scale the image to the strip"));
+    return false;
+  }
+  return true;
+}
+
+bool DrawEngine::startPattern(const char *name, const PatternParams& params, uint32_t rows, uint16_t leds, uint8_t pin,
+                              OutputType output, uint32_t line_us, uint32_t countdown_ms){
+  if(busy()){
+    Serial.println(F("Already drawing"));
+    return false;
+  }
+  release();
+  strncpy(_filename, name, sizeof(_filename) - 1);
+  _filename[sizeof(_filename) - 1] = 0;
+
+  _pattern = createPattern(_filename);
+  if(!_pattern){
+    Serial.println(F("Unknown pattern"));
+    return false;
+  }
+  _pattern->begin(leds, rows, line_us, params);
+  //rows are computed in the countdown and between the lines like file rows are read
+  return begin(_pattern, ROW_RING_SLOTS, leds, pin, output, line_us, countdown_ms);
+}
+
+bool DrawEngine::startPlaylist(const PlaylistEntry* entries, uint8_t count, const PatternParams& params, uint32_t pattern_rows,
+                               uint16_t leds, uint8_t pin, OutputType output, uint32_t line_us, uint32_t countdown_ms){
+  if(busy()){
+    Serial.println(F("Already drawing"));
+    return false;
+  }
+  release();
+  strcpy(_filename, "playlist");
+  _params = params;
+  _pattern_rows = pattern_rows;
+  _leds = leds;
+
+  if(!_playlist.begin(entries, count, line_us, leds, _resample, *this)){
+    Serial.println(F("Error playlist entry can't be drawn"));
+    release();
+    return false;
+  }
+  //the first entry sets the line time of the first row
+  return begin(&_playlist, ROW_RING_SLOTS, leds, pin, output, _playlist.linePeriod(0), countdown_ms);
+}
+
+RowSource* DrawEngine::openEntry(const PlaylistEntry& entry, uint32_t line_us){
+  uint32_t header_start;
+  size_t len;
+
+  closeEntry();
+  if(entry.name[0] != '/'){
+    if((_pattern = createPattern(entry.name)) == NULL)
+      return NULL;
+    _pattern->begin(_leds, _pattern_rows, line_us, _params);
+    return _pattern;
+  }
+  //only what is cached already, filling the cache would stall the drawing
+  const uint8_t * data = imageCache.find(entry.name, &len);
+  header_start = metrics.start();
+  if(data){
+    _mem.set(data, len);
+    if(!_img.open(&_mem))
+      return NULL;
+    imageCache.pin(entry.name);
+    _cached = true;
+  }
+  else if(openImageFile(entry.name, _file, _img, _fileSrc) < 0){
+    return NULL;
+  }
+  metrics.record(METRIC_HEADER, header_start);
+  return &_img;
+}
+
+void DrawEngine::closeEntry(){
+  if(_file)
+    _file.close();
+  if(_cached){
+    imageCache.unpin();
+    _cached = false;
+  }
+  delete _pattern;
+  _pattern = NULL;
+}
+
+bool DrawEngine::uses(const char *name) const{
+  if(!busy())
+    return false;
+  if(_source == &_playlist)
+    return _playlist.contains(name);
+  return _source == &_img && !_cached && !strcmp(name, _filename);
+}
+
+bool DrawEngine::begin(RowSource* source, uint8_t ring_slots, uint16_t leds, uint8_t pin, OutputType output,
+                       uint32_t line_us, uint32_t countdown_ms){
+  _source = source;
+  _leds = leds;
+  _pin = pin;
+  _output_type = output;
+  _line_us = line_us;
+  _countdown_ms = countdown_ms;
+  _countdown_start = millis();
+
+  if(!_pipeline.begin(source, ring_slots, leds)){
+    release();
+    return false;
+  }
+
+  _state = DRAW_COUNTDOWN;
+  return true;
+}
+
+bool DrawEngine::startStream(StreamProtocol protocol, uint16_t universe, uint16_t leds, uint8_t pin, OutputType output){
+  if(busy()){
+    Serial.println(F("Already drawing"));
+    return false;
+  }
+  release();
+  strcpy(_filename, FrameStream::name(protocol));
+  _output = createStripOutput(output, leds, pin);
+  if(!_output){
+    Serial.println(F("Error no output for the strip"));
+    return false;
+  }
+  if(!_udp.begin(FrameStream::port(protocol))){
+    Serial.println(F("Error can't listen for the stream"));
+    release();
+    return false;
+  }
+  _output->clear();
+  _stream.begin(&_udp, protocol, universe, _output, leds);
+  _state = DRAW_STREAMING;
+  Serial.print(F("Streaming ")); Serial.print(_filename);
+  Serial.print(F(" on port ")); Serial.println(FrameStream::port(protocol));
+  return true;
+}
+
+void DrawEngine::stop(){
+  if(!busy())
+    return;
+  Serial.println(F("Drawing stopped"));
+  finish();
+}
+
+void DrawEngine::tick(){
+  switch(_state){
+    case DRAW_COUNTDOWN:
+      //use the countdown to read ahead
+      if(_pipeline.preload())
+        return;
+      if(_pipeline.failed()){
+        Serial.println(F("Error reading the image"));
+        finish();
+        return;
+      }
+      if(millis() - _countdown_start < _countdown_ms)
+        return;
+      _output = createStripOutput(_output_type, _leds, _pin);
+      if(!_output){
+        Serial.println(F("Error no output for the strip"));
+        finish();
+        return;
+      }
+      _state = DRAW_PLAYING;
+      Serial.print(F("Drawing ")); Serial.println(millis());
+      _pipeline.start(_output, _line_us);
+      if(!_pipeline.service())
+        finish();
+      break;
+    case DRAW_PLAYING:
+      if(!_pipeline.service()){
+        if(_pipeline.failed())
+          Serial.println(F("Error reading the image"));
+        finish();
+      }
+      break;
+    case DRAW_STREAMING:
+      _stream.poll();
+      break;
+    default:
+      break;
+  }
+}
+
+void DrawEngine::finish(){
+  if(_output){
+    //Clear pixels
+    _output->clear();
+    if(_state == DRAW_PLAYING)
+      printLineStats();
+  }
+  Serial.print(F("Drawing done ")); Serial.println(millis());
+  release();
+  _state = DRAW_DONE;
+}
+
+void DrawEngine::release(){
+  _pipeline.end();
+  if(_stream.active()){
+    _stream.end();
+    _udp.end();
+  }
+  delete _output;
+  _output = NULL;
+  _playlist.end();
+  closeEntry();
+  _source = NULL;
+}
+
+const char *DrawEngine::stateName() const{
+  switch(_state){
+    case DRAW_COUNTDOWN: return "countdown";
+    case DRAW_PLAYING: return "playing";
+    case DRAW_DONE: return "done";
+    case DRAW_STREAMING: return "streaming";
+    default: return "idle";
+  }
+}
+
+void DrawEngine::printLineStats(){
+  const LineScheduler::Stats& stats = _scheduler.stats();
+  if(stats.lines == 0)
+    return;
+  Serial.print(F("Lines: ")); Serial.print(stats.lines);
+  Serial.print(F(" Late: ")); Serial.print(stats.late_lines);
+  Serial.print(F(" Max late: ")); Serial.print(stats.max_late_us);
+  Serial.print(F("us Avg late: ")); Serial.print(stats.total_late_us / stats.lines);
+  Serial.print(F("us Resyncs: ")); Serial.println(stats.resyncs);
+}
@@ -0,0 +1,97 @@
+#ifndef DRAW_ENGINE_H
+#define DRAW_ENGINE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ImageFormat.h"
+#include "SpiffsStream.h"
+#include "LineScheduler.h"
+#include "ColorLut.h"
+#include "EspOutput.h"
+#include "RowPipeline.h"
+#include "Pattern.h"
+#include "Playlist.h"
+#include "FrameStream.h"
+#include "EspUdp.h"
+
+enum DrawState { DRAW_IDLE, DRAW_COUNTDOWN, DRAW_PLAYING, DRAW_DONE, DRAW_STREAMING };
+
+// Draws an image without blocking: start() opens it, tick() is called from
+// loop() and does whatever is due (countdown, reading ahead, pushing a row on
+// its line edge) and returns in between, so the web server keeps running.
+// The rows themselves go through a RowPipeline, this is the SPIFFS, cache
+// and strip side of it. For playlists it opens the entries for the
+// PlaylistSource. Instead of drawing it can show frames streamed over UDP.
+class DrawEngine : public PlaylistSource::Opener {
+  public:
+    DrawEngine(LineScheduler& scheduler, const ColorLut& lut);
+
+    // false if already drawing or the image can't be drawn
+    bool start(const char *filename, uint16_t leds, uint8_t pin, OutputType output, uint32_t line_us, uint32_t countdown_ms);
+    // draws rows of the named pattern instead of an image (rows is ignored by text)
+    bool startPattern(const char *name, const PatternParams& params, uint32_t rows, uint16_t leds, uint8_t pin,
+                      OutputType output, uint32_t line_us, uint32_t countdown_ms);
+    // draws the entries back to back, patterns among them use params and pattern_rows
+    bool startPlaylist(const PlaylistEntry* entries, uint8_t count, const PatternParams& params, uint32_t pattern_rows,
+                       uint16_t leds, uint8_t pin, OutputType output, uint32_t line_us, uint32_t countdown_ms);
+    // shows frames received on the port of protocol until stop()
+    bool startStream(StreamProtocol protocol, uint16_t universe, uint16_t leds, uint8_t pin, OutputType output);
+    void stop();
+    // lines per row and blending between rows, for the next start()
+    void setStretch(uint8_t stretch, bool interpolate) { _pipeline.setStretch(stretch, interpolate); }
+    // how images are scaled to the strip length, for the next start()
+    void setResample(ResampleMode mode) { _resample = mode; _pipeline.setResample(mode); }
+    void tick();
+
+    DrawState state() const { return _state; }
+    const char *stateName() const;
+    bool busy() const { return _state == DRAW_COUNTDOWN || _state == DRAW_PLAYING || _state == DRAW_STREAMING; }
+    // false when the next row edge is too close for other work
+    bool canService() const { return _state != DRAW_PLAYING || _pipeline.canService(); }
+    const char *filename() const { return _filename; }   // or the pattern name
+    uint32_t row() const { return _pipeline.shown(); }     // rows shown so far
+    uint32_t rows() const { return _source ? _source->rows() : 0; }
+    bool cached() const { return _cached; }
+    // true while name is read from SPIFFS for the drawing
+    bool uses(const char *name) const;
+    const FrameStream& stream() const { return _stream; }
+
+    // PlaylistSource::Opener
+    RowSource* openEntry(const PlaylistEntry& entry, uint32_t line_us);
+    void closeEntry();
+
+  private:
+    bool begin(RowSource* source, uint8_t ring_slots, uint16_t leds, uint8_t pin, OutputType output,
+               uint32_t line_us, uint32_t countdown_ms);
+    void finish();
+    void release();
+    void printLineStats();
+
+    LineScheduler& _scheduler;
+    RowPipeline _pipeline;
+    StripOutput *_output;
+    File _file;
+    FileSource _fileSrc;
+    MemorySource _mem;
+    ImageSource _img;
+    Pattern *_pattern;
+    RowSource *_source;     // _img, _pattern or _playlist
+    PlaylistSource _playlist;
+    PatternParams _params;  // for patterns in the playlist
+    uint32_t _pattern_rows;
+    ResampleMode _resample;
+    FrameStream _stream;
+    UdpSource _udp;
+
+    DrawState _state;
+    char _filename[32];
+    uint8_t _pin;
+    OutputType _output_type;
+    uint16_t _leds;
+    uint32_t _line_us;
+    uint32_t _countdown_ms;
+    uint32_t _countdown_start;
+    bool _cached;
+};
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include "EspOutput.h"
+#include "WsEncoder.h"
+
+#define UART_FIFO_SIZE 128
+#define UART_FIFO_REFILL 64         // refill interrupt when the FIFO runs below this
+
+#define FLASH_PINS 0x0FC0             // GPIO6..11
+#define SERIAL_PINS 0x000A            // GPIO1 and 3, TX and RX of Serial
+
+static StripSegment segments[SEGMENTS_MAX];
+static uint8_t segment_count;
+
+void setStripSegments(const StripSegment* list, uint8_t count){
+  segment_count = count < SEGMENTS_MAX ? count : SEGMENTS_MAX;
+  memcpy(segments, list, segment_count * sizeof(StripSegment));
+}
+
+StripOutput* createStripOutput(OutputType type, uint16_t leds, uint8_t pin){
+  StripOutput* output;
+
+  if(type == OUTPUT_PARALLEL){
+    output = new ParallelOutput();
+    if(output->begin(leds, pin))
+      return output;
+    delete output;
+    Serial.println(F("Segments not valid, using NeoPixel"));
+  }
+  if(type == OUTPUT_UART){
+    output = new UartOutput();
+    if(output->begin(leds, pin))
+      return output;
+    delete output;
+    Serial.println(F("UART output not available, using NeoPixel"));
+  }
+  output = new NeoPixelOutput();
+  if(output->begin(leds, pin))
+    return output;
+  delete output;
+  return NULL;
+}
+
+bool NeoPixelOutput::begin(uint16_t leds, uint8_t pin){
+  end();
+  _leds = leds;
+  _pin = pin;
+  pinMode(_pin, OUTPUT);
+  _strip = new Adafruit_NeoPixel(leds, pin, NEO_GRB + NEO_KHZ800);
+  return _strip->getPixels() != NULL;
+}
+
+void NeoPixelOutput::end(){
+  if(!_strip)
+    return;
+  delete _strip;
+  _strip = NULL;
+  //switch pin back to input
+  pinMode(_pin, INPUT);
+}
+
+bool UartOutput::begin(uint16_t leds, uint8_t pin){
+  end();
+  if(pin != UART_OUTPUT_PIN)
+    return false;
+  _leds = leds;
+  _len = leds * 3;
+  _front = (uint8_t *)calloc(_len, 1);
+  _back = (uint8_t *)calloc(_len, 1);
+  if(!_front || !_back){
+    end();
+    return false;
+  }
+  _next = _end = _front;
+
+  ETS_UART_INTR_DISABLE();
+  pinMode(UART_OUTPUT_PIN, SPECIAL);                      // GPIO2 as U1TXD
+  USD(1) = ESP8266_CLOCK / WS_UART_BAUD;
+  USC0(1) = (1 << UCBN) | (1 << UCSBN) | (1 << UCTXI);    // 6 data bits, 1 stop bit, TX inverted
+  USC0(1) |= (1 << UCTXRST);                              // empty the TX FIFO
+  USC0(1) &= ~(1 << UCTXRST);
+  USC1(1) = UART_FIFO_REFILL << UCFET;
+  USIE(1) = 0;
+  USIC(1) = 0xffff;
+  USIE(0) = 0;                                            // UART0 shares the interrupt
+  USIC(0) = 0xffff;
+  ETS_UART_INTR_ATTACH(isr, this);
+  ETS_UART_INTR_ENABLE();
+  _ready_at = micros() + WS_LATCH_US;
+  return true;
+}
+
+void UartOutput::end(){
+  if(!_front && !_back)
+    return;
+  if(_len)
+    wait();
+  ETS_UART_INTR_DISABLE();
+  USIE(1) = 0;
+  free(_front);
+  free(_back);
+  _front = _back = NULL;
+  _len = 0;
+  pinMode(UART_OUTPUT_PIN, INPUT);
+  Serial.begin(115200);                                   // gives the UART interrupt back to Serial
+}
+
+void UartOutput::show(){
+  uint8_t* sent;
+
+  wait();
+  sent = _front;
+  _front = _back;
+  _back = sent;
+  //the next row will be written completely, so no need to copy the old one
+
+  _end = _front + _len;
+  _next = _front;
+  _ready_at = micros() + _len * WS_BYTE_US + WS_LATCH_US;
+  ETS_UART_INTR_DISABLE();
+  fill();
+  if(_next < _end)
+    USIE(1) |= (1 << UIFE);
+  ETS_UART_INTR_ENABLE();
+}
+
+void UartOutput::wait(){
+  while(sending() || (int32_t)(micros() - _ready_at) < 0)
+    ;
+}
+
+bool UartOutput::sending() const{
+  return _next < _end || ((USS(1) >> USTXC) & 0xff) > 0;
+}
+
+void ICACHE_RAM_ATTR UartOutput::fill(){
+  const uint8_t* next = _next;
+  while(next < _end && ((USS(1) >> USTXC) & 0xff) <= UART_FIFO_SIZE - WS_UART_BYTES_PER_BYTE){
+    uint8_t v = *next++;
+    USF(1) = wsUartCodes[(v >> 6) & 3];
+    USF(1) = wsUartCodes[(v >> 4) & 3];
+    USF(1) = wsUartCodes[(v >> 2) & 3];
+    USF(1) = wsUartCodes[v & 3];
+  }
+  _next = next;
+}
+
+void ICACHE_RAM_ATTR UartOutput::isr(void* arg){
+  UartOutput* self = (UartOutput*)arg;
+  if(USIS(1) & (1 << UIFE)){
+    self->fill();
+    if(self->_next >= self->_end)
+      USIE(1) &= ~(1 << UIFE);
+  }
+  USIC(1) = 0xffff;
+  USIC(0) = 0xffff;
+}
+
+bool ParallelOutput::begin(uint16_t leds, uint8_t pin){
+  end();
+  //a strip on the Serial pins would get the log and break it for the PC
+  if(!_encoder.begin(segments, segment_count, leds) || (_encoder.pins() & (FLASH_PINS | SERIAL_PINS))){
+    _encoder.end();
+    return false;
+  }
+  _leds = leds;
+  _buf = (uint8_t *)calloc(leds, 3);
+  if(!_buf){
+    end();
+    return false;
+  }
+  for(uint8_t i = 0; i < SEGMENT_PIN_MAX + 1; i++){
+    if(_encoder.pins() & (1 << i)){
+      pinMode(i, OUTPUT);
+      digitalWrite(i, LOW);
+    }
+  }
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  _bit = WS_BIT_NS * mhz / 1000;
+  _t0h = WS_T0H_NS * mhz / 1000;
+  _t1h = WS_T1H_NS * mhz / 1000;
+  _ready_at = micros() + WS_LATCH_US;
+  Serial.print(F("Parallel output, longest segment ")); Serial.println(_encoder.longest());
+  return true;
+}
+
+void ParallelOutput::end(){
+  if(_encoder.pins()){
+    for(uint8_t i = 0; i < SEGMENT_PIN_MAX + 1; i++)
+      if(_encoder.pins() & (1 << i))
+        pinMode(i, INPUT);
+  }
+  _encoder.end();
+  free(_buf);
+  _buf = NULL;
+}
+
+void ParallelOutput::show(){
+  //encoding overlaps the latch time of the last row
+  _encoder.encode(_buf);
+  while((int32_t)(micros() - _ready_at) < 0)
+    ;
+  noInterrupts();
+  send();
+  interrupts();
+  _ready_at = micros() + WS_LATCH_US;
+}
+
+void ICACHE_RAM_ATTR ParallelOutput::send(){
+  const uint16_t* plane = _encoder.planes();
+  const uint16_t* end = plane + _encoder.bits();
+  uint32_t all = _encoder.pins();
+  uint32_t start = ESP.getCycleCount() - _bit;
+
+  while(plane < end){
+    uint32_t zeros = all & ~*plane++;
+    while(ESP.getCycleCount() - start < _bit)
+      ;
+    start = ESP.getCycleCount();
+    GPOS = all;
+    while(ESP.getCycleCount() - start < _t0h)
+      ;
+    GPOC = zeros;
+    while(ESP.getCycleCount() - start < _t1h)
+      ;
+    GPOC = all;
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef ESP_OUTPUT_H
+#define ESP_OUTPUT_H
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include "StripOutput.h"
+#include "StripSegments.h"
+
+#define UART_OUTPUT_PIN 2           // UART1 TX (D4 on the NodeMCU)
+
+// creates the output for type, falls back to NeoPixel if it can't start
+StripOutput* createStripOutput(OutputType type, uint16_t leds, uint8_t pin);
+// segments of the row for OUTPUT_PARALLEL, copied
+void setStripSegments(const StripSegment* segments, uint8_t count);
+
+// Bit-banged by Adafruit_NeoPixel, show() blocks with interrupts disabled
+class NeoPixelOutput : public StripOutput {
+  public:
+    NeoPixelOutput() : _strip(NULL), _pin(0) {}
+    ~NeoPixelOutput() { end(); }
+    bool begin(uint16_t leds, uint8_t pin);
+    void end();
+    uint8_t* pixels() { return _strip->getPixels(); }
+    void show() { _strip->show(); }
+  private:
+    Adafruit_NeoPixel* _strip;
+    uint8_t _pin;
+};
+
+// Sent by UART1 from its TX FIFO, refilled by the FIFO empty interrupt. show()
+// only starts the transfer and swaps buffers, so the next row is prepared
+// while the current one goes out. Only on UART_OUTPUT_PIN, and it takes over
+// the UART interrupt (Serial can't receive while it is in use).
+class UartOutput : public StripOutput {
+  public:
+    UartOutput() : _front(NULL), _back(NULL), _len(0), _next(NULL), _end(NULL), _ready_at(0) {}
+    ~UartOutput() { end(); }
+    bool begin(uint16_t leds, uint8_t pin);
+    void end();
+    uint8_t* pixels() { return _back; }
+    void show();
+
+  private:
+    static void isr(void* arg);
+    void fill();
+    void wait();
+    bool sending() const;
+
+    uint8_t* _front;    // on the wire
+    uint8_t* _back;     // next row
+    size_t _len;
+    const uint8_t* volatile _next;
+    const uint8_t* _end;
+    uint32_t _ready_at; // micros() when the last row is out and latched
+};
+
+// All segments bit-banged at once, one GPIO mask per WS2812 bit from
+// ParallelEncoder. show() blocks with interrupts disabled like NeoPixel, but
+// only for the longest segment instead of the whole row. pin is not used,
+// the pins come from setStripSegments(). Pins 6 to 11 are the flash, 1 and 3
+// are Serial, segments on them are refused.
+class ParallelOutput : public StripOutput {
+  public:
+    ParallelOutput() : _buf(NULL), _ready_at(0) {}
+    ~ParallelOutput() { end(); }
+    bool begin(uint16_t leds, uint8_t pin);
+    void end();
+    uint8_t* pixels() { return _buf; }
+    void show();
+
+  private:
+    void send();
+
+    ParallelEncoder _encoder;
+    uint8_t* _buf;
+    uint32_t _bit;      // cycles of a bit, of the high time of a 0 and of a 1
+    uint32_t _t0h;
+    uint32_t _t1h;
+    uint32_t _ready_at; // micros() when the last row is latched
+};
+
+#endif
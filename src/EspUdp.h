@@ -0,0 +1,18 @@
+#ifndef ESP_UDP_H
+#define ESP_UDP_H
+
+#include <WiFiUdp.h>
+#include "FrameStream.h"
+
+// PacketSource on a WiFiUDP socket, unicast only
+class UdpSource : public PacketSource {
+  public:
+    bool begin(uint16_t port) { return _udp.begin(port) != 0; }
+    void end() { _udp.stop(); }
+    int parsePacket() { return _udp.parsePacket(); }
+    size_t read(uint8_t* buf, size_t len) { int n = _udp.read(buf, len); return n > 0 ? n : 0; }
+  private:
+    WiFiUDP _udp;
+};
+
+#endif
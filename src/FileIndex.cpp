@@ -0,0 +1,141 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "FileIndex.h"
+
+#define FILE_INDEX_GROW 16
+
+FileIndex::FileIndex() : _entries(NULL), _count(0), _capacity(0) {
+}
+
+FileIndex::~FileIndex(){
+  clear();
+}
+
+void FileIndex::clear(){
+  free(_entries);
+  _entries = NULL;
+  _count = _capacity = 0;
+}
+
+int FileIndex::search(const char* name, bool* found) const{
+  int lo = 0, hi = _count;
+
+  //first entry not below name
+  while(lo < hi){
+    int mid = (lo + hi) / 2;
+    if(strcmp(_entries[mid].name, name) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *found = lo < _count && strcmp(_entries[lo].name, name) == 0;
+  return lo;
+}
+
+bool FileIndex::add(const char* name, uint32_t size){
+  bool found;
+  int i;
+
+  if(strlen(name) >= FILE_INDEX_NAME_LEN)
+    return false;
+  i = search(name, &found);
+  if(!found){
+    if(_count == _capacity){
+      //grown in steps, hundreds of files would otherwise realloc per file at boot
+      Entry* grown = (Entry*)realloc(_entries, (_capacity + FILE_INDEX_GROW) * sizeof(Entry));
+      if(!grown)
+        return false;
+      _entries = grown;
+      _capacity += FILE_INDEX_GROW;
+    }
+    memmove(&_entries[i + 1], &_entries[i], (_count - i) * sizeof(Entry));
+    _count++;
+    strcpy(_entries[i].name, name);
+  }
+  Entry& e = _entries[i];
+  e.size = size;
+  e.rows = 0;
+  e.width = 0;
+  e.type = IMAGE_NONE;
+  e.info_pending = isImage(name);
+  e.crc_known = false;
+  e.crc = 0;
+  return true;
+}
+
+void FileIndex::remove(const char* name){
+  bool found;
+  int i = search(name, &found);
+
+  if(!found)
+    return;
+  memmove(&_entries[i], &_entries[i + 1], (_count - i - 1) * sizeof(Entry));
+  _count--;
+}
+
+const FileIndex::Entry* FileIndex::find(const char* name) const{
+  bool found;
+  int i = search(name, &found);
+  return found ? &_entries[i] : NULL;
+}
+
+const FileIndex::Entry* FileIndex::findWithGz(const char* name, const Entry** gz) const{
+  bool found;
+  int i = search(name, &found);
+  size_t len = strlen(name);
+  const Entry* plain = found ? &_entries[i] : NULL;
+
+  //name.gz sorts after name, behind other names starting with name
+  *gz = NULL;
+  for(i += found; i < _count && !strncmp(_entries[i].name, name, len); i++){
+    if(!strcmp(_entries[i].name + len, ".gz")){
+      *gz = &_entries[i];
+      break;
+    }
+  }
+  return plain;
+}
+
+void FileIndex::setCrc(const char* name, uint32_t crc){
+  bool found;
+  int i = search(name, &found);
+
+  if(!found)
+    return;
+  _entries[i].crc = crc;
+  _entries[i].crc_known = true;
+}
+
+FileIndex::Entry* FileIndex::pending(){
+  for(uint16_t i = 0; i < _count; i++){
+    if(_entries[i].info_pending)
+      return &_entries[i];
+  }
+  return NULL;
+}
+
+bool FileIndex::isImage(const char* name){
+  size_t len = strlen(name);
+  return len > 4 && (!strcmp(name + len - 4, ".bmp") || !strcmp(name + len - 4, ".lpf"));
+}
@@ -0,0 +1,57 @@
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ImageFormat.h"
+
+#define FILE_INDEX_NAME_LEN 32    // SPIFFS names incl. the terminating 0
+
+// Names and sizes of the files on SPIFFS, and for images their size and
+// format, kept sorted in RAM so a lookup is a binary search instead of a
+// directory walk. Whoever writes or removes a file updates the index; the
+// image headers are parsed later (see indexNextImage()), until then an
+// image has type IMAGE_NONE and info_pending set.
+class FileIndex {
+  public:
+    struct Entry {
+      char name[FILE_INDEX_NAME_LEN];
+      uint32_t size;
+      uint32_t rows;
+      uint16_t width;
+      uint8_t type;           // ImageType
+      bool info_pending;      // .bmp/.lpf whose header wasn't read yet
+      bool crc_known;
+      uint32_t crc;           // CRC32 of the content, for the ETag
+    };
+
+    FileIndex();
+    ~FileIndex();
+
+    void clear();
+    // adds name or updates its size, an image gets its header read again and
+    // the CRC is unknown until setCrc()
+    bool add(const char* name, uint32_t size);
+    void remove(const char* name);
+    void setCrc(const char* name, uint32_t crc);
+    const Entry* find(const char* name) const;
+    // name and name.gz with one search, both NULL if they don't exist
+    const Entry* findWithGz(const char* name, const Entry** gz) const;
+    bool contains(const char* name) const { return find(name) != NULL; }
+
+    uint16_t count() const { return _count; }
+    const Entry& at(uint16_t i) const { return _entries[i]; }
+    // next image without header info, NULL when all are known
+    Entry* pending();
+
+    static bool isImage(const char* name);
+
+  private:
+    int search(const char* name, bool* found) const;
+
+    Entry* _entries;
+    uint16_t _count;
+    uint16_t _capacity;
+};
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <string.h>
+#include "FrameStream.h"
+
+#define DDP_HEADER 10
+#define DDP_TIMECODE 4
+#define E131_ROOT 22                // up to the root layer vector
+#define E131_SYNC 49
+#define ARTNET_ID 10                // "Art-Net" and the opcode
+#define ARTNET_DMX 18
+
+static uint16_t be16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+static uint32_t be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3]; }
+
+FrameStream::FrameStream(const ColorLut& lut, ClockFunc clock)
+  : _lut(lut), _clock(clock), _src(NULL), _output(NULL), _protocol(STREAM_OFF), _universe(0), _leds(0), _last_slot(0),
+    _seq_seen(0), _sync(false), _sync_at(0), _frame_open(false), _frame_start(0), _last_show(0), _last_interval(0) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void FrameStream::begin(PacketSource* src, StreamProtocol protocol, uint16_t universe, StripOutput* output, uint16_t leds){
+  _src = src;
+  _protocol = protocol;
+  _universe = universe;
+  _output = output;
+  _leds = leds;
+  _last_slot = leds ? (leds * 3 - 1) / STREAM_UNIVERSE_BYTES : 0;
+  _seq_seen = 0;
+  _sync = false;
+  _frame_open = false;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void FrameStream::end(){
+  _src = NULL;
+  _output = NULL;
+}
+
+uint8_t FrameStream::poll(uint8_t max_packets){
+  uint8_t frames = 0;
+  int size;
+
+  //a few packets per call, so a flood doesn't keep loop() from the web server
+  while(_src && max_packets-- > 0 && (size = _src->parsePacket()) > 0){
+    if(handlePacket(size))
+      frames++;
+  }
+  return frames;
+}
+
+bool FrameStream::handlePacket(int size){
+  uint32_t now = _clock();
+  Packet p;
+  int8_t kind;
+
+  _stats.packets++;
+  memset(&p, 0, sizeof(p));
+  p.slot = -1;
+  switch(_protocol){
+    case STREAM_DDP: kind = decodeDdp(size, p); break;
+    case STREAM_E131: kind = decodeE131(size, p); break;
+    case STREAM_ARTNET: kind = decodeArtNet(size, p); break;
+    default: kind = -1; break;
+  }
+  if(kind < 0){
+    _stats.invalid++;
+    return false;
+  }
+  if(kind == 0){
+    //sync packet, from now on frames are shown only on these
+    _sync = true;
+    _sync_at = now;
+    if(!_frame_open)
+      return false;
+    show();
+    return true;
+  }
+  if(!checkSequence(p))
+    return false;
+  if(_sync && now - _sync_at > STREAM_SYNC_TIMEOUT_MS * 1000UL)
+    _sync = false;
+  if(!_frame_open){
+    _frame_open = true;
+    _frame_start = now;
+  }
+
+  uint32_t bytes = (uint32_t)_leds * 3;
+  if(p.offset < bytes && p.length > 0){
+    uint8_t* dst = _output->pixels() + p.offset;
+    size_t n = p.length < bytes - p.offset ? p.length : bytes - p.offset;
+    n = _src->read(dst, n) / 3;
+    //RGB on the network, GRB on the strip
+    for(size_t i = 0; i < n; i++){
+      uint8_t r = dst[i * 3];
+      dst[i * 3] = dst[i * 3 + 1];
+      dst[i * 3 + 1] = r;
+    }
+    _lut.apply(dst, n, _stats.frames % _lut.phases());
+  }
+  if(p.push || (p.last && !_sync)){
+    show();
+    return true;
+  }
+  return false;
+}
+
+int8_t FrameStream::decodeDdp(int size, Packet& p){
+  uint8_t* h = _header;
+  size_t len = DDP_HEADER;
+
+  if(size < DDP_HEADER || _src->read(h, DDP_HEADER) != DDP_HEADER)
+    return -1;
+  //version 1, and no query or reply
+  if((h[0] & 0xC6) != 0x40)
+    return -1;
+  if(h[0] & 0x10){
+    if(size < DDP_HEADER + DDP_TIMECODE || _src->read(h + DDP_HEADER, DDP_TIMECODE) != DDP_TIMECODE)
+      return -1;
+    len += DDP_TIMECODE;
+  }
+  if(h[3] != 1)             // display, other ids are config and status
+    return -1;
+  p.offset = be32(h + 4);
+  p.length = be16(h + 8);
+  if(p.length > size - len)
+    p.length = size - len;
+  //pixels have to start at a pixel, the RGB order is swapped in place
+  if(p.offset % 3)
+    return -1;
+  p.length -= p.length % 3;
+  p.seq = h[1] & 0x0F;
+  p.slot = p.seq ? 0 : -1;
+  p.push = h[0] & 0x01;
+  return 1;
+}
+
+int8_t FrameStream::decodeE131(int size, Packet& p){
+  uint8_t* h = _header;
+  uint16_t universe;
+
+  if(size < E131_ROOT || _src->read(h, E131_ROOT) != E131_ROOT)
+    return -1;
+  if(be16(h) != 0x0010 || memcmp(h + 4, "ASC-E1.17", 10) != 0)
+    return -1;
+  switch(be32(h + 18)){
+    case 0x00000008:        // extended, synchronization
+      if(size < E131_SYNC || _src->read(h + E131_ROOT, E131_SYNC - E131_ROOT) != E131_SYNC - E131_ROOT)
+        return -1;
+      return be32(h + 40) == 0x00000001 ? 0 : -1;
+    case 0x00000004:        // data
+      break;
+    default:
+      return -1;
+  }
+  if(size < STREAM_HEADER_MAX || _src->read(h + E131_ROOT, STREAM_HEADER_MAX - E131_ROOT) != STREAM_HEADER_MAX - E131_ROOT)
+    return -1;
+  //DMX data with start code 0, no preview data and the stream not terminated
+  if(be32(h + 40) != 0x00000002 || h[117] != 0x02 || h[125] != 0 || (h[112] & 0xC0))
+    return -1;
+  universe = be16(h + 113);
+  if(universe < _universe)
+    return -1;
+  p.offset = (uint32_t)(universe - _universe) * STREAM_UNIVERSE_BYTES;
+  p.length = be16(h + 123) > 0 ? be16(h + 123) - 1 : 0;
+  if(p.length > size - STREAM_HEADER_MAX)
+    p.length = size - STREAM_HEADER_MAX;
+  p.length -= p.length % 3;
+  p.seq = h[111];
+  p.slot = universe - _universe < STREAM_UNIVERSES ? universe - _universe : -1;
+  p.last = universe - _universe == _last_slot;
+  //with a sync address the frame waits for the sync packet
+  _sync = be16(h + 109) != 0;
+  _sync_at = _clock();
+  return 1;
+}
+
+int8_t FrameStream::decodeArtNet(int size, Packet& p){
+  uint8_t* h = _header;
+  uint16_t universe;
+
+  if(size < ARTNET_ID || _src->read(h, ARTNET_ID) != ARTNET_ID || memcmp(h, "Art-Net", 8) != 0)
+    return -1;
+  switch(h[8] | (h[9] << 8)){
+    case 0x5200:            // ArtSync
+      return 0;
+    case 0x5000:            // ArtDmx
+      break;
+    default:
+      return -1;
+  }
+  if(size < ARTNET_DMX || _src->read(h + ARTNET_ID, ARTNET_DMX - ARTNET_ID) != ARTNET_DMX - ARTNET_ID)
+    return -1;
+  universe = h[14] | ((h[15] & 0x7F) << 8);
+  if(universe < _universe)
+    return -1;
+  p.offset = (uint32_t)(universe - _universe) * STREAM_UNIVERSE_BYTES;
+  p.length = be16(h + 16);
+  if(p.length > size - ARTNET_DMX)
+    p.length = size - ARTNET_DMX;
+  p.length -= p.length % 3;
+  p.seq = h[12];
+  p.slot = p.seq && universe - _universe < STREAM_UNIVERSES ? universe - _universe : -1;
+  p.last = universe - _universe == _last_slot;
+  return 1;
+}
+
+bool FrameStream::checkSequence(const Packet& p){
+  uint32_t bit;
+  uint8_t d;
+
+  if(p.slot < 0)
+    return true;
+  bit = 1UL << p.slot;
+  if(_seq_seen & bit){
+    //DDP counts 1..15, Art-Net 1..255 and E1.31 0..255
+    if(_protocol == STREAM_DDP)
+      d = (p.seq + 15 - _seq[p.slot]) % 15;
+    else if(_protocol == STREAM_ARTNET)
+      d = (p.seq + 255 - _seq[p.slot]) % 255;
+    else
+      d = p.seq - _seq[p.slot];
+    //repeated, or up to 19 behind as E1.31 asks receivers to discard
+    //(-19..-1 is 237..255), one 20 or more behind is taken as new
+    if(d == 0 || (_protocol != STREAM_DDP && d >= 237)){
+      _stats.out_of_order++;
+      return false;
+    }
+    _stats.dropped += d - 1;
+  }
+  _seq[p.slot] = p.seq;
+  _seq_seen |= bit;
+  return true;
+}
+
+void FrameStream::show(){
+  uint32_t now, latency, interval;
+
+  _output->show();
+  now = _clock();
+  latency = now - _frame_start;
+  _stats.total_latency_us += latency;
+  if(latency > _stats.max_latency_us)
+    _stats.max_latency_us = latency;
+  if(_stats.frames > 0){
+    interval = now - _last_show;
+    if(_stats.frames > 1){
+      uint32_t jitter = interval > _last_interval ? interval - _last_interval : _last_interval - interval;
+      _stats.total_jitter_us += jitter;
+      if(jitter > _stats.max_jitter_us)
+        _stats.max_jitter_us = jitter;
+    }
+    _last_interval = interval;
+  }
+  _last_show = now;
+  _stats.frames++;
+  _frame_open = false;
+}
+
+uint16_t FrameStream::port(StreamProtocol protocol){
+  switch(protocol){
+    case STREAM_DDP: return STREAM_DDP_PORT;
+    case STREAM_E131: return STREAM_E131_PORT;
+    case STREAM_ARTNET: return STREAM_ARTNET_PORT;
+    default: return 0;
+  }
+}
+
+const char* FrameStream::name(StreamProtocol protocol){
+  switch(protocol){
+    case STREAM_DDP: return "ddp";
+    case STREAM_E131: return "e131";
+    case STREAM_ARTNET: return "artnet";
+    default: return "off";
+  }
+}
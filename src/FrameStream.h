@@ -0,0 +1,105 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ColorLut.h"
+#include "StripOutput.h"
+
+#define STREAM_DDP_PORT 4048
+#define STREAM_E131_PORT 5568
+#define STREAM_ARTNET_PORT 6454
+#define STREAM_HEADER_MAX 126       // E1.31 data packet, the longest header
+#define STREAM_UNIVERSES 16         // universes whose sequence numbers are followed
+#define STREAM_UNIVERSE_BYTES 510   // 170 pixels per DMX universe
+#define STREAM_SYNC_TIMEOUT_MS 4000 // Art-Net falls back to showing on the last universe without ArtSync
+
+enum StreamProtocol { STREAM_OFF, STREAM_DDP, STREAM_E131, STREAM_ARTNET };
+
+// UDP packets one after the other. parsePacket() drops what is left of the
+// previous packet and returns the size of the next one, 0 if there is none
+class PacketSource {
+  public:
+    virtual ~PacketSource() {}
+    virtual int parsePacket() = 0;
+    virtual size_t read(uint8_t* buf, size_t len) = 0;
+};
+
+// Live RGB frames from the network straight to the strip: DDP (raw RGB with
+// a byte offset, port 4048), E1.31 (sACN) or Art-Net DMX, one universe of
+// 170 pixels after the other from the configured first one. Only the header
+// of a packet is read into RAM, the pixel data is read directly into the
+// pixel buffer of the output, reordered to GRB and put through the ColorLut
+// in place. The frame is shown on its sync point: the DDP push flag, an
+// E1.31 or Art-Net sync packet if the sender uses them, otherwise the
+// packet of the last universe the strip needs.
+//
+// A frame should cover the whole strip, with the double buffered UART
+// output pixels not sent in a frame are those of the frame before last.
+class FrameStream {
+  public:
+    typedef uint32_t (*ClockFunc)();    // free running microsecond counter
+
+    struct Stats {
+      uint32_t packets;
+      uint32_t frames;
+      uint32_t dropped;           // packets missing by their sequence number
+      uint32_t out_of_order;      // late or repeated packets, not shown
+      uint32_t invalid;           // not a packet of the protocol or not for us
+      uint32_t max_latency_us;    // first packet of a frame to show()
+      uint32_t total_latency_us;
+      uint32_t max_jitter_us;     // difference between successive frame intervals
+      uint32_t total_jitter_us;
+    };
+
+    FrameStream(const ColorLut& lut, ClockFunc clock);
+
+    void begin(PacketSource* src, StreamProtocol protocol, uint16_t universe, StripOutput* output, uint16_t leds);
+    void end();
+    // handles up to max_packets waiting packets, returns the frames shown
+    uint8_t poll(uint8_t max_packets = 8);
+
+    bool active() const { return _src != NULL; }
+    StreamProtocol protocol() const { return _protocol; }
+    const Stats& stats() const { return _stats; }
+    static uint16_t port(StreamProtocol protocol);
+    static const char* name(StreamProtocol protocol);
+
+  private:
+    struct Packet {
+      uint32_t offset;            // byte in the strip buffer
+      uint16_t length;
+      int16_t slot;               // universe index for the sequence, -1 for none
+      uint8_t seq;
+      bool last;                  // completes a frame without sync
+      bool push;                  // show after this packet
+    };
+
+    bool handlePacket(int size);
+    int8_t decodeDdp(int size, Packet& p);
+    int8_t decodeE131(int size, Packet& p);
+    int8_t decodeArtNet(int size, Packet& p);
+    bool checkSequence(const Packet& p);
+    void show();
+
+    const ColorLut& _lut;
+    ClockFunc _clock;
+    PacketSource* _src;
+    StripOutput* _output;
+    StreamProtocol _protocol;
+    uint16_t _universe;
+    uint16_t _leds;
+    uint16_t _last_slot;          // universe index which completes the strip
+    uint8_t _header[STREAM_HEADER_MAX];
+    uint8_t _seq[STREAM_UNIVERSES];
+    uint32_t _seq_seen;           // bit per universe index with a sequence number
+    bool _sync;                   // the sender uses sync packets
+    uint32_t _sync_at;            // clock of the last sync packet
+    bool _frame_open;             // packets of a frame arrived since the last show()
+    uint32_t _frame_start;
+    uint32_t _last_show;
+    uint32_t _last_interval;
+    Stats _stats;
+};
+
+#endif
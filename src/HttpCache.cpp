@@ -0,0 +1,108 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+#include "HttpCache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_STATIC "max-age=3600"
+#define CACHE_CHECK "no-cache"
+
+void formatEtag(char* buf, uint32_t size, uint32_t crc){
+  snprintf(buf, ETAG_LEN, "\"%x-%08x\"", (unsigned)size, (unsigned)crc);
+}
+
+bool etagMatches(const char* header, const char* etag){
+  size_t len = strlen(etag);
+  const char* p = header;
+
+  while(*p){
+    while(*p == ' ' || *p == ',')
+      p++;
+    if(*p == '*')
+      return true;
+    if(!strncmp(p, "W/", 2))
+      p += 2;
+    if(!strncmp(p, etag, len) && (p[len] == 0 || p[len] == ',' || p[len] == ' '))
+      return true;
+    //next entry
+    while(*p && *p != ',')
+      p++;
+  }
+  return false;
+}
+
+int8_t parseRange(const char* header, uint32_t size, uint32_t* start, uint32_t* len){
+  const char* p;
+  char* end;
+  uint32_t first, last;
+
+  if(strncmp(header, "bytes=", 6) || strchr(header, ','))
+    return 0;
+  p = header + 6;
+  if(*p == '-'){
+    //the last n bytes
+    last = strtoul(p + 1, &end, 10);
+    if(end == p + 1 || *end)
+      return 0;
+    if(last == 0 || size == 0)
+      return -1;
+    first = last < size ? size - last : 0;
+    last = size - 1;
+  }
+  else{
+    first = strtoul(p, &end, 10);
+    if(end == p || *end != '-')
+      return 0;
+    p = end + 1;
+    last = *p ? strtoul(p, &end, 10) : size - 1;
+    if(*p && (*end || last < first))
+      return 0;
+    if(first >= size)
+      return -1;
+    if(last >= size)
+      last = size - 1;
+  }
+  *start = first;
+  *len = last - first + 1;
+  return 1;
+}
+
+const char* cacheControl(const char* path){
+  static const char* const assets[] = { ".css", ".js", ".ico", ".woff", ".woff2", ".ttf" };
+  const char* dot = strrchr(path, '.');
+
+  if(dot && !strcmp(dot, ".gz")){
+    //the type is that of the name without .gz
+    for(dot--; dot > path && *dot != '.'; dot--)
+      ;
+  }
+  if(!dot)
+    return CACHE_CHECK;
+  for(size_t i = 0; i < sizeof(assets) / sizeof(assets[0]); i++){
+    size_t len = strlen(assets[i]);
+    if(!strncmp(dot, assets[i], len) && (dot[len] == 0 || dot[len] == '.'))
+      return CACHE_STATIC;
+  }
+  return CACHE_CHECK;
+}
@@ -0,0 +1,28 @@
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ETAG_LEN 20                 // "size-crc" in hex with the quotes
+
+// Helpers for conditional and partial file requests. SPIFFS keeps no
+// modification times, so the validator is an ETag made of size and CRC32.
+
+// writes the quoted ETag for a file into buf (ETAG_LEN bytes)
+void formatEtag(char* buf, uint32_t size, uint32_t crc);
+
+// true if the If-None-Match header lists etag (weak or strong) or is "*"
+bool etagMatches(const char* header, const char* etag);
+
+// Range header for a file of size bytes: 1 and start/len for one
+// satisfiable range, 0 to send the whole file (no or unsupported range,
+// like several ranges), -1 if it starts past the end
+int8_t parseRange(const char* header, uint32_t size, uint32_t* start, uint32_t* len);
+
+// Cache-Control for path: styles, scripts, the icon and fonts are kept an
+// hour. Everything else, images of any type in particular (they can be
+// uploaded again under the same name), is checked every time
+const char* cacheControl(const char* path);
+
+#endif
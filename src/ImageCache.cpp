@@ -0,0 +1,148 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "ImageCache.h"
+
+ImageCache::ImageCache() : _pinned(-1), _pinned_stale(false), _budget(0), _used(0), _tick(0) {
+  memset(_entries, 0, sizeof(_entries));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+ImageCache::~ImageCache(){
+  clear();
+}
+
+void ImageCache::setBudget(size_t bytes){
+  _budget = bytes;
+  while(_used > _budget && evictOldest());
+}
+
+uint8_t ImageCache::entries() const{
+  uint8_t n = 0;
+  for(int i = 0; i < IMAGE_CACHE_ENTRIES; i++)
+    if(_entries[i].data) n++;
+  return n;
+}
+
+int ImageCache::indexOf(const char* name) const{
+  for(int i = 0; i < IMAGE_CACHE_ENTRIES; i++)
+    if(_entries[i].data && !strcmp(_entries[i].name, name))
+      return i;
+  return -1;
+}
+
+const uint8_t* ImageCache::find(const char* name, size_t* len){
+  int i = indexOf(name);
+  if(i < 0){
+    _stats.misses++;
+    return NULL;
+  }
+  _stats.hits++;
+  _entries[i].last_use = ++_tick;
+  *len = _entries[i].len;
+  return _entries[i].data;
+}
+
+bool ImageCache::contains(const char* name) const{
+  return indexOf(name) >= 0;
+}
+
+uint8_t* ImageCache::reserve(const char* name, size_t len){
+  int i;
+
+  invalidate(name);
+  if(len == 0 || len > _budget || strlen(name) >= IMAGE_CACHE_NAME_LEN)
+    return NULL;
+  while(_used + len > _budget && evictOldest());
+
+  for(i = 0; i < IMAGE_CACHE_ENTRIES && _entries[i].data; i++);
+  if(i == IMAGE_CACHE_ENTRIES){
+    //all entries taken, make room for one more
+    evictOldest();
+    for(i = 0; i < IMAGE_CACHE_ENTRIES && _entries[i].data; i++);
+    if(i == IMAGE_CACHE_ENTRIES)
+      return NULL;
+  }
+
+  Entry& e = _entries[i];
+  e.data = (uint8_t *)malloc(len);
+  if(!e.data)
+    return NULL;
+  strcpy(e.name, name);
+  e.len = len;
+  e.last_use = ++_tick;
+  _used += len;
+  return e.data;
+}
+
+void ImageCache::invalidate(const char* name){
+  int i = indexOf(name);
+  if(i >= 0)
+    drop(i);
+}
+
+void ImageCache::clear(){
+  for(int i = 0; i < IMAGE_CACHE_ENTRIES; i++)
+    if(_entries[i].data) drop(i);
+}
+
+void ImageCache::pin(const char* name){
+  unpin();
+  _pinned = indexOf(name);
+}
+
+void ImageCache::unpin(){
+  int i = _pinned;
+  _pinned = -1;
+  if(i >= 0 && _pinned_stale){
+    _pinned_stale = false;
+    drop(i);
+  }
+}
+
+void ImageCache::drop(int index){
+  Entry& e = _entries[index];
+  if(index == _pinned){
+    //still drawn from, hide it and free it once unpinned
+    e.name[0] = 0;
+    _pinned_stale = true;
+    return;
+  }
+  free(e.data);
+  _used -= e.len;
+  memset(&e, 0, sizeof(e));
+}
+
+bool ImageCache::evictOldest(){
+  int oldest = -1;
+  for(int i = 0; i < IMAGE_CACHE_ENTRIES; i++){
+    if(i == _pinned)
+      continue;
+    if(_entries[i].data && (oldest < 0 || _entries[i].last_use < _entries[oldest].last_use))
+      oldest = i;
+  }
+  if(oldest < 0)
+    return false;
+  drop(oldest);
+  _stats.evictions++;
+  return true;
+}
@@ -0,0 +1,68 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IMAGE_CACHE_ENTRIES 4
+#define IMAGE_CACHE_NAME_LEN 32
+
+// Keeps whole images in RAM (as .lpf data, so rows are ready for the strip)
+// to skip SPIFFS on repeated shots. Entries are keyed by the file name that
+// is drawn and the least recently used ones are dropped to stay within the
+// byte budget.
+class ImageCache {
+  public:
+    struct Stats {
+      uint32_t hits;
+      uint32_t misses;
+      uint32_t evictions;
+    };
+
+    ImageCache();
+    ~ImageCache();
+
+    void setBudget(size_t bytes);     // evicts until the cache fits
+    size_t budget() const { return _budget; }
+    size_t used() const { return _used; }
+    uint8_t entries() const;
+
+    // cached data of name or NULL, counted as hit/miss
+    const uint8_t* find(const char* name, size_t* len);
+    bool contains(const char* name) const;
+
+    // allocates len bytes for name (replacing an older entry of the same
+    // name) and evicts until it fits. NULL if it can't fit the budget
+    uint8_t* reserve(const char* name, size_t len);
+    void invalidate(const char* name);
+    void clear();
+
+    // keeps the entry of name alive while it is drawn: it is neither evicted
+    // nor freed by invalidate()/clear() until unpin()
+    void pin(const char* name);
+    void unpin();
+
+    const Stats& stats() const { return _stats; }
+
+  private:
+    struct Entry {
+      char name[IMAGE_CACHE_NAME_LEN];
+      uint8_t* data;
+      size_t len;
+      uint32_t last_use;
+    };
+
+    int indexOf(const char* name) const;
+    void drop(int index);
+    bool evictOldest();
+
+    Entry _entries[IMAGE_CACHE_ENTRIES];
+    int _pinned;          // entry in use by the draw engine, -1 for none
+    bool _pinned_stale;   // pinned entry was invalidated, drop it on unpin()
+    size_t _budget;
+    size_t _used;
+    uint32_t _tick;
+    Stats _stats;
+};
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "ImageFormat.h"
+
+#define BMP_HEADER_SIZE 54
+#define BMP_MASKS_SIZE 12         // colour masks after the header of BI_BITFIELDS images
+#define BMP_RGB 0                 // compression types
+#define BMP_RLE8 1
+#define BMP_RLE4 2
+#define BMP_BITFIELDS 3
+#define BMP_CHUNK_PIXELS 16       // 32 Bit rows and palettes are read in chunks of this many entries
+
+static uint16_t le16(const uint8_t* p){
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t* p){
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t* p, uint16_t v){
+  p[0] = v; p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v){
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+size_t MemorySource::read(uint8_t* buf, size_t len){
+  if(len > _len - _pos)
+    len = _len - _pos;
+  memcpy(buf, _data + _pos, len);
+  _pos += len;
+  return len;
+}
+
+bool MemorySource::seek(uint32_t pos){
+  if(pos > _len)
+    return false;
+  _pos = pos;
+  return true;
+}
+
+size_t MemorySink::write(const uint8_t* buf, size_t len){
+  if(len > _len - _pos)
+    len = _len - _pos;
+  memcpy(_data + _pos, buf, len);
+  _pos += len;
+  return len;
+}
+
+ImageSource::ImageSource()
+  : _src(NULL), _type(IMAGE_NONE), _width(0), _rows(0), _offset(0), _stride(0), _bpp(0),
+    _compression(BMP_RGB), _top_down(false), _palette(NULL) {
+}
+
+ImageSource::~ImageSource(){
+  free(_palette);
+}
+
+bool ImageSource::open(ByteSource* src){
+  uint8_t header[BMP_HEADER_SIZE + BMP_MASKS_SIZE];   // large enough for both formats
+
+  _src = src;
+  _type = IMAGE_NONE;
+  _compression = BMP_RGB;
+  _top_down = false;
+  free(_palette);
+  _palette = NULL;
+  // one read for the whole header instead of reading it byte by byte
+  memset(header, 0, sizeof(header));
+  if(!_src->seek(0) || _src->read(header, sizeof(header)) < LPF_HEADER_SIZE)
+    return false;
+
+  if(header[0] == 'B' && header[1] == 'M')
+    return openBmp(header);
+  if(!memcmp(header, LPF_MAGIC, 4))
+    return openLpf(header);
+  return false;
+}
+
+bool ImageSource::openBmp(const uint8_t* header){
+  int32_t width  = le32(header + 18);
+  int32_t height = le32(header + 22);
+  uint16_t bpp = le16(header + 28);
+  uint32_t compression = le32(header + 30);
+  uint32_t colors = le32(header + 46);
+
+  // Must be one plane and a depth/compression we can decode
+  if(le16(header + 26) != 1)
+    return false;
+  switch(compression){
+    case BMP_RGB:
+      if(bpp != 4 && bpp != 8 && bpp != 24 && bpp != 32)
+        return false;
+      break;
+    case BMP_RLE8:
+    case BMP_RLE4:
+      if(bpp != (compression == BMP_RLE8 ? 8 : 4) || height < 0)
+        return false;
+      break;
+    case BMP_BITFIELDS:
+      // only the usual BGRA layout
+      if(bpp != 32 || le32(header + 54) != 0xFF0000 || le32(header + 58) != 0xFF00 || le32(header + 62) != 0xFF)
+        return false;
+      compression = BMP_RGB;
+      break;
+    default:
+      return false;
+  }
+  if(width <= 0 || width > 0xFFFF || height == 0 || height == INT32_MIN)
+    return false;
+
+  _width  = width;
+  _rows   = height < 0 ? -height : height;
+  _top_down = height < 0;
+  _bpp    = bpp;
+  _compression = compression;
+  _offset = le32(header + 10);
+  _stride = ((width * bpp + 31) / 32) * 4;   // BMP rows are padded (if needed) to 4-byte boundary
+  if(bpp <= 8){
+    // the palette follows the info header, the colours used or all of them
+    if(colors == 0 || colors > (1u << bpp))
+      colors = 1 << bpp;
+    if(!readPalette(14 + le32(header + 14), colors))
+      return false;
+  }
+  if(_compression != BMP_RGB)
+    restartRle();
+  _type   = IMAGE_BMP;
+  return true;
+}
+
+bool ImageSource::readPalette(uint32_t pos, uint16_t count){
+  uint8_t buf[BMP_CHUNK_PIXELS * 4];
+
+  // all 1 << bpp entries, indices past the used colours are black
+  _palette = (uint8_t *)calloc(1 << _bpp, 3);
+  if(!_palette || !_src->seek(pos))
+    return false;
+  for(uint16_t i = 0; i < count; ){
+    uint16_t n = count - i < BMP_CHUNK_PIXELS ? count - i : BMP_CHUNK_PIXELS;
+    if(_src->read(buf, n * 4) != n * 4u)
+      return false;
+    // BGRX to GRB
+    for(uint8_t* p = buf; n > 0; n--, i++, p += 4){
+      _palette[i * 3]     = p[1];
+      _palette[i * 3 + 1] = p[2];
+      _palette[i * 3 + 2] = p[0];
+    }
+  }
+  return true;
+}
+
+bool ImageSource::openLpf(const uint8_t* header){
+  if(le16(header + 4) < LPF_HEADER_SIZE || header[12] != 3 || header[13] != LPF_ORDER_GRB)
+    return false;
+  if(le16(header + 14) != LPF_GAMMA_LINEAR)
+    return false;
+
+  _width  = le16(header + 6);
+  _rows   = le32(header + 8);
+  _offset = le16(header + 4);
+  _stride = _width * 3;
+  _bpp    = 24;
+  _type   = IMAGE_LPF;
+  return _width > 0;
+}
+
+bool ImageSource::readRow(uint32_t row, uint8_t* dst){
+  if(_type == IMAGE_NONE || row >= _rows)
+    return false;
+  if(_compression != BMP_RGB)
+    return readRleRow(row, dst);
+
+  // top-down BMPs store the rows the other way round
+  uint32_t pos = _offset + (_top_down ? _rows - 1 - row : row) * _stride;
+  if(_src->position() != pos && !_src->seek(pos))
+    return false;
+  if(_bpp == 32){
+    readBgra(dst);
+  }
+  else if(_bpp < 24){
+    // the packed indices go to the end of dst and are expanded from the front
+    size_t len = (_width * _bpp + 7) / 8;
+    if(_src->read(dst + _width * 3 - len, len) != len)
+      return false;
+    expandIndexed(dst);
+  }
+  else{
+    size_t len = _width * 3;
+    if(_src->read(dst, len) != len)
+      return false;
+    if(_type == IMAGE_BMP)
+      convertBgrRow(dst, _width);
+  }
+  return true;
+}
+
+void ImageSource::readBgra(uint8_t* dst){
+  uint8_t buf[BMP_CHUNK_PIXELS * 4];
+
+  for(uint16_t i = 0; i < _width; ){
+    uint16_t n = _width - i < BMP_CHUNK_PIXELS ? _width - i : BMP_CHUNK_PIXELS;
+    size_t got = _src->read(buf, n * 4) / 4;
+    if(got < n)
+      memset(buf + got * 4, 0, (n - got) * 4);
+    for(uint8_t* p = buf; n > 0; n--, i++, p += 4, dst += 3){
+      dst[0] = p[1];
+      dst[1] = p[2];
+      dst[2] = p[0];
+    }
+  }
+}
+
+void ImageSource::expandIndexed(uint8_t* dst){
+  const uint8_t* src = dst + _width * 3 - (_width * _bpp + 7) / 8;
+  const uint8_t* c;
+
+  // a pixel is written only after its index was read, the indices still to
+  // come are always behind the pixels written so far
+  if(_bpp == 8){
+    for(uint16_t i = 0; i < _width; i++, dst += 3){
+      c = _palette + *src++ * 3;
+      dst[0] = c[0]; dst[1] = c[1]; dst[2] = c[2];
+    }
+    return;
+  }
+  for(uint16_t i = 0; i < _width; i += 2, dst += 6){
+    uint8_t v = *src++;
+    c = _palette + (v >> 4) * 3;
+    dst[0] = c[0]; dst[1] = c[1]; dst[2] = c[2];
+    if(i + 1 < _width){
+      c = _palette + (v & 0x0F) * 3;
+      dst[3] = c[0]; dst[4] = c[1]; dst[5] = c[2];
+    }
+  }
+}
+
+void ImageSource::restartRle(){
+  _rle_row = 0;
+  _rle_skip = 0;
+  _rle_x = 0;
+  _rle_done = false;
+  _buf_at = _offset;
+  _buf_len = _buf_pos = 0;
+}
+
+int ImageSource::rleByte(){
+  if(_buf_pos == _buf_len){
+    if(_src->position() != _buf_at && !_src->seek(_buf_at))
+      return -1;
+    _buf_len = _src->read(_buf, sizeof(_buf));
+    _buf_pos = 0;
+    _buf_at += _buf_len;
+    if(_buf_len == 0)
+      return -1;
+  }
+  return _buf[_buf_pos++];
+}
+
+bool ImageSource::readRleRow(uint32_t row, uint8_t* dst){
+  if(row < _rle_row)
+    restartRle();
+  while(_rle_row < row)
+    if(!decodeRleRow(NULL))
+      return false;
+  return decodeRleRow(dst);
+}
+
+// Decodes the next row, into dst if it isn't NULL. Pixels the RLE data
+// skips (by a delta or an early end of line) are black.
+bool ImageSource::decodeRleRow(uint8_t* dst){
+  bool rle4 = _compression == BMP_RLE4;
+  uint16_t x;
+  int n, v;
+
+  if(dst)
+    memset(dst, 0, _width * 3);
+  if(_rle_skip > 0 || _rle_done){
+    if(_rle_skip > 0)
+      _rle_skip--;
+    _rle_row++;
+    return true;
+  }
+  x = _rle_x;
+  _rle_x = 0;
+
+#define RLE_PUT(index) do { if(dst && x < _width) memcpy(dst + x * 3, _palette + (index) * 3, 3); x++; } while(0)
+  for(;;){
+    if((n = rleByte()) < 0 || (v = rleByte()) < 0)
+      return false;
+    if(n > 0){
+      // run of n pixels, RLE4 alternates between the two nibbles
+      for(int i = 0; i < n; i++)
+        RLE_PUT(rle4 ? (i & 1 ? v & 0x0F : v >> 4) : v);
+    }
+    else if(v == 0){
+      break;                          // end of line
+    }
+    else if(v == 1){
+      _rle_done = true;               // end of bitmap
+      break;
+    }
+    else if(v == 2){
+      // delta: right and up, the rows in between stay blank
+      int dx = rleByte(), dy = rleByte();
+      if(dx < 0 || dy < 0)
+        return false;
+      x += dx;
+      if(dy > 0){
+        _rle_skip = dy - 1;
+        _rle_x = x;
+        break;
+      }
+    }
+    else{
+      // v literal pixels, padded to a 16 bit boundary
+      int bytes = rle4 ? (v + 1) / 2 : v;
+      int b = 0;
+      for(int i = 0; i < v; i++){
+        if(!rle4 || !(i & 1))
+          if((b = rleByte()) < 0)
+            return false;
+        RLE_PUT(rle4 ? (i & 1 ? b & 0x0F : b >> 4) : b);
+      }
+      if((bytes & 1) && rleByte() < 0)
+        return false;
+    }
+  }
+#undef RLE_PUT
+  _rle_row++;
+  return true;
+}
+
+#define BYTE_AT(v, shift) (((v) >> (shift)) & 0xFF)
+
+void convertBgrRow(uint8_t* row, uint16_t width){
+  uint8_t b;
+  uint16_t i = 0;
+
+  if(((uintptr_t)row & 3) == 0){
+    // four pixels at once as three 32 bit words (little endian)
+    //   in:  b0 g0 r0 b1 | g1 r1 b2 g2 | r2 b3 g3 r3
+    //   out: g0 r0 b0 g1 | r1 b1 g2 r2 | b2 g3 r3 b3
+    uint32_t* w = (uint32_t*)row;
+    for(; i + 4 <= width; i += 4, w += 3){
+      uint32_t w0 = w[0], w1 = w[1], w2 = w[2];
+      w[0] = BYTE_AT(w0, 8)  | BYTE_AT(w0, 16) << 8 | BYTE_AT(w0, 0)  << 16 | BYTE_AT(w1, 0)  << 24;
+      w[1] = BYTE_AT(w1, 8)  | BYTE_AT(w0, 24) << 8 | BYTE_AT(w1, 24) << 16 | BYTE_AT(w2, 0)  << 24;
+      w[2] = BYTE_AT(w1, 16) | BYTE_AT(w2, 16) << 8 | BYTE_AT(w2, 24) << 16 | BYTE_AT(w2, 8)  << 24;
+    }
+    row = (uint8_t*)w;
+  }
+  for(; i < width; i++, row += 3) {
+    b = row[0];
+    row[0] = row[1];
+    row[1] = row[2];
+    row[2] = b;
+  }
+}
+
+bool lpfFilename(const char* filename, char* out, size_t len){
+  size_t n = strlen(filename);
+  if(n < 4 || n >= len || strcmp(filename + n - 4, ".bmp"))
+    return false;
+  memcpy(out, filename, n - 4);
+  strcpy(out + n - 4, ".lpf");
+  return true;
+}
+
+uint32_t lpfSize(const ImageSource& img){
+  return LPF_HEADER_SIZE + (uint32_t)img.width() * 3 * img.rows();
+}
+
+bool writeLpf(ImageSource& img, ByteSink& out, uint8_t* rowbuf){
+  uint8_t header[LPF_HEADER_SIZE];
+  size_t len = img.width() * 3;
+
+  memcpy(header, LPF_MAGIC, 4);
+  put16(header + 4, LPF_HEADER_SIZE);
+  put16(header + 6, img.width());
+  put32(header + 8, img.rows());
+  header[12] = 3;
+  header[13] = LPF_ORDER_GRB;
+  put16(header + 14, LPF_GAMMA_LINEAR);
+  if(out.write(header, sizeof(header)) != sizeof(header))
+    return false;
+
+  for(uint32_t row = 0; row < img.rows(); row++){
+    if(!img.readRow(row, rowbuf) || out.write(rowbuf, len) != len)
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,149 @@
+#ifndef IMAGE_FORMAT_H
+#define IMAGE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LPF_MAGIC "LPF1"
+#define LPF_HEADER_SIZE 16
+#define LPF_ORDER_GRB 0
+#define LPF_GAMMA_LINEAR 0    // rows are stored without gamma, the ColorLut is applied when drawing
+
+// Minimal byte stream interfaces so the image code runs on SPIFFS files as
+// well as on plain files on the PC (see tools/bmp2lpf.cpp)
+class ByteSource {
+  public:
+    virtual ~ByteSource() {}
+    virtual size_t read(uint8_t* buf, size_t len) = 0;
+    virtual bool seek(uint32_t pos) = 0;
+    virtual uint32_t position() = 0;
+};
+
+class ByteSink {
+  public:
+    virtual ~ByteSink() {}
+    virtual size_t write(const uint8_t* buf, size_t len) = 0;
+};
+
+// ByteSource/ByteSink on a block of RAM, e.g. an image held in the ImageCache
+class MemorySource : public ByteSource {
+  public:
+    MemorySource() : _data(NULL), _len(0), _pos(0) {}
+    void set(const uint8_t* data, size_t len) { _data = data; _len = len; _pos = 0; }
+    size_t read(uint8_t* buf, size_t len);
+    bool seek(uint32_t pos);
+    uint32_t position() { return _pos; }
+  private:
+    const uint8_t* _data;
+    size_t _len;
+    size_t _pos;
+};
+
+class MemorySink : public ByteSink {
+  public:
+    MemorySink(uint8_t* data, size_t len) : _data(data), _len(len), _pos(0) {}
+    size_t write(const uint8_t* buf, size_t len);
+  private:
+    uint8_t* _data;
+    size_t _len;
+    size_t _pos;
+};
+
+enum ImageType { IMAGE_NONE, IMAGE_BMP, IMAGE_LPF };
+
+// Anything that hands out strip rows: an image file or a generated pattern
+class RowSource {
+  public:
+    virtual ~RowSource() {}
+    virtual uint16_t width() const = 0;
+    virtual uint32_t rows() const = 0;
+    // writes row into dst as width() * 3 bytes GRB, linear
+    virtual bool readRow(uint32_t row, uint8_t* dst) = 0;
+    // line time of row in us if the source sets it (playlists), 0 otherwise
+    virtual uint32_t linePeriod(uint32_t /*row*/) const { return 0; }
+};
+
+// Native strip frame format (.lpf), all fields little endian:
+//   0  char[4]  LPF_MAGIC
+//   4  uint16   header size, offset of the first row (LPF_HEADER_SIZE)
+//   6  uint16   pixels per row
+//   8  uint32   number of rows
+//  12  uint8    bytes per pixel (3)
+//  13  uint8    pixel order (LPF_ORDER_GRB)
+//  14  uint16   gamma x100 applied to the rows, only LPF_GAMMA_LINEAR is
+//               supported (files of older versions had the gamma applied)
+// The rows follow directly: width * 3 bytes each, in the wire order of the
+// strip and without padding.
+
+// An opened .bmp or .lpf image which hands out rows ready for the strip.
+// BMPs can be 24 Bit, 32 Bit (alpha is ignored), or 8/4 Bit with a palette,
+// uncompressed or RLE8/RLE4. The palette is converted to GRB once when the
+// image is opened, so an indexed row costs one 3 byte copy per pixel. RLE
+// rows can only be decoded one after the other, reading them in order is
+// cheap, going back restarts at the first row.
+class ImageSource : public RowSource {
+  public:
+    ImageSource();
+    ~ImageSource();
+
+    bool open(ByteSource* src);     // parses the header, false if not supported
+    ImageType type() const { return _type; }
+    uint16_t width() const { return _width; }
+    uint32_t rows() const { return _rows; }
+    uint8_t bitsPerPixel() const { return _bpp; }
+    bool indexed() const { return _palette != NULL; }
+
+    // reads row into dst as width * 3 bytes GRB, linear. Row 0 is the bottom
+    // row of the image (the first row in the file of a normal BMP)
+    bool readRow(uint32_t row, uint8_t* dst);
+
+  private:
+    ImageSource(const ImageSource&);
+    ImageSource& operator=(const ImageSource&);
+
+    bool openBmp(const uint8_t* header);
+    bool openLpf(const uint8_t* header);
+    bool readPalette(uint32_t pos, uint16_t count);
+    void readBgra(uint8_t* dst);
+    void expandIndexed(uint8_t* dst);
+    bool readRleRow(uint32_t row, uint8_t* dst);
+    bool decodeRleRow(uint8_t* dst);
+    void restartRle();
+    int rleByte();
+
+    ByteSource* _src;
+    ImageType _type;
+    uint16_t _width;
+    uint32_t _rows;
+    uint32_t _offset;   // first row in the file
+    uint32_t _stride;   // bytes from row to row
+    uint8_t _bpp;
+    uint8_t _compression;
+    bool _top_down;     // BMP with negative height, the first row in the file is the top
+    uint8_t* _palette;  // GRB, 1 << _bpp entries
+
+    // RLE decoder state
+    uint32_t _rle_row;  // next row decodeRleRow() produces
+    uint32_t _rle_skip; // blank rows left from a delta
+    uint16_t _rle_x;    // where the row after a delta continues
+    bool _rle_done;     // end of bitmap seen, the remaining rows are blank
+    uint32_t _buf_at;   // file position of the next buffer fill
+    uint8_t _buf[32];
+    uint8_t _buf_len;
+    uint8_t _buf_pos;
+};
+
+// BGR (as stored in a BMP) to GRB, in place. Word aligned rows are
+// converted four pixels at a time.
+void convertBgrRow(uint8_t* row, uint16_t width);
+
+// "/name.bmp" -> "/name.lpf", false if filename is no .bmp or out is too small
+bool lpfFilename(const char* filename, char* out, size_t len);
+
+// size of img written as .lpf
+uint32_t lpfSize(const ImageSource& img);
+
+// writes img as .lpf to out, rowbuf must hold width * 3 bytes
+bool writeLpf(ImageSource& img, ByteSink& out, uint8_t* rowbuf);
+
+#endif
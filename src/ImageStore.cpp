@@ -0,0 +1,205 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include "ImageStore.h"
+
+ImageCache imageCache;
+FileIndex fileIndex;
+
+int transcodeToLpf(const String& filename){
+  char lpfname[32];
+  ImageSource img;
+  uint8_t * rowbuf;
+  bool ok;
+
+  if(!lpfFilename(filename.c_str(), lpfname, sizeof(lpfname)))
+    return -1;
+  SPIFFS.remove(lpfname);   // never keep a frame file of an older upload
+  fileIndex.remove(lpfname);
+
+  File in = SPIFFS.open(filename, "r");
+  if(!in)
+    return -1;
+  FileSource src(in);
+  if(!img.open(&src) || img.type() != IMAGE_BMP){
+    Serial.println(F("Unsupported BMP, not converted"));
+    in.close();
+    return -1;
+  }
+  if(img.indexed()){
+    //palette images are drawn from the BMP, as .lpf they would take 3 bytes per pixel
+    Serial.println(F("Indexed BMP, kept as is"));
+    in.close();
+    return 0;
+  }
+  rowbuf = (uint8_t *)malloc(img.width() * 3);
+  File out = SPIFFS.open(lpfname, "w");
+  if(!rowbuf || !out){
+    free(rowbuf);
+    in.close();
+    return -1;
+  }
+  FileSink sink(out);
+  ok = writeLpf(img, sink, rowbuf);
+  out.close();
+  in.close();
+  free(rowbuf);
+  if(!ok){
+    Serial.println(F("Failed to write frame file"));
+    SPIFFS.remove(lpfname);
+    return -1;
+  }
+  indexFile(lpfname);
+  Serial.print(F("Converted to ")); Serial.println(lpfname);
+  return 0;
+}
+
+int makeThumbnail(const char *filename){
+  char thumbname[32];
+  File file;
+  FileSource src(file);
+  ImageSource img;
+  bool ok;
+
+  if(!thumbFilename(filename, thumbname, sizeof(thumbname)))
+    return -1;
+  SPIFFS.remove(thumbname);   // never keep the preview of an older upload
+  fileIndex.remove(thumbname);
+  //the .lpf if there is one, its rows are read without decoding
+  if(openImageFile(filename, file, img, src) < 0)
+    return -1;
+  File out = SPIFFS.open(thumbname, "w");
+  if(!out){
+    file.close();
+    return -1;
+  }
+  FileSink sink(out);
+  ok = writeThumbnail(img, sink);
+  out.close();
+  file.close();
+  if(!ok){
+    Serial.println(F("Failed to write thumbnail"));
+    SPIFFS.remove(thumbname);
+    return -1;
+  }
+  indexFile(thumbname);
+  return 0;
+}
+
+int openImageFile(const char *filename, File& file, ImageSource& img, FileSource& src){
+  char lpfname[32];
+
+  if (lpfFilename(filename, lpfname, sizeof(lpfname)) && fileIndex.contains(lpfname)) {
+    file = SPIFFS.open(lpfname, "r");
+    if (file && img.open(&src))
+      return 0;
+    file.close();
+  }
+  // Check file exists and open it
+  if (!(file = SPIFFS.open(filename, "r"))) {
+    Serial.println(F("File not found")); // Can comment out if not needed
+    return -1;
+  }
+  if (!img.open(&src)) {
+    Serial.println(F("Unsupported image format"));
+    file.close();
+    return -1;
+  }
+  return 0;
+}
+
+const uint8_t * cacheImage(const char *filename, size_t *len){
+  File file;
+  FileSource src(file);
+  ImageSource img;
+  uint8_t * data;
+  uint8_t * rowbuf;
+  bool ok;
+
+  if((data = (uint8_t *)imageCache.find(filename, len)) != NULL)
+    return data;
+  if(imageCache.budget() == 0 || openImageFile(filename, file, img, src) < 0)
+    return NULL;
+
+  *len = lpfSize(img);
+  if(*len > imageCache.budget() || ESP.getFreeHeap() < *len + img.width() * 3 + CACHE_HEAP_RESERVE){
+    file.close();
+    return NULL;
+  }
+  rowbuf = (uint8_t *)malloc(img.width() * 3);
+  data = imageCache.reserve(filename, *len);
+  if(rowbuf && data){
+    MemorySink sink(data, *len);
+    ok = writeLpf(img, sink, rowbuf);
+  }
+  else
+    ok = false;
+  free(rowbuf);
+  file.close();
+  if(!ok){
+    imageCache.invalidate(filename);
+    return NULL;
+  }
+  return data;
+}
+
+void indexFiles(){
+  Dir dir = SPIFFS.openDir("/");
+
+  fileIndex.clear();
+  while(dir.next()){
+    if(!fileIndex.add(dir.fileName().c_str(), dir.fileSize())){
+      Serial.println(F("File index full"));
+      break;
+    }
+  }
+}
+
+void indexFile(const char *filename){
+  File file = SPIFFS.open(filename, "r");
+
+  if(!file){
+    fileIndex.remove(filename);
+    return;
+  }
+  fileIndex.add(filename, file.size());
+  file.close();
+}
+
+bool indexNextImage(){
+  FileIndex::Entry* entry = fileIndex.pending();
+  ImageSource img;
+
+  if(!entry)
+    return false;
+  entry->info_pending = false;
+  File file = SPIFFS.open(entry->name, "r");
+  if(!file)
+    return true;
+  FileSource src(file);
+  if(img.open(&src)){
+    entry->type = img.type();
+    entry->width = img.width();
+    entry->rows = img.rows();
+  }
+  file.close();
+  return true;
+}
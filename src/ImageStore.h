@@ -0,0 +1,37 @@
+#ifndef IMAGE_STORE_H
+#define IMAGE_STORE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "ImageFormat.h"
+#include "ImageCache.h"
+#include "FileIndex.h"
+#include "SpiffsStream.h"
+#include "Thumbnail.h"
+
+#define CACHE_HEAP_RESERVE 16384    // heap which is always left for WiFi and the web server
+
+extern ImageCache imageCache;
+extern FileIndex fileIndex;
+
+// converts an uploaded /name.bmp to /name.lpf
+int transcodeToLpf(const String& filename);
+
+// writes the preview /name.tmb of an uploaded /name.bmp
+int makeThumbnail(const char *filename);
+
+// opens filename for drawing, the preconverted .lpf if there is one
+int openImageFile(const char *filename, File& file, ImageSource& img, FileSource& src);
+
+// loads filename into the image cache if it fits the budget and the heap,
+// returns the cached .lpf data or NULL
+const uint8_t * cacheImage(const char *filename, size_t *len);
+
+// builds the file index from the SPIFFS directory, image headers are left pending
+void indexFiles();
+// brings the entry of filename up to date after it was written or removed
+void indexFile(const char *filename);
+// reads the header of one pending image, false if there was none
+bool indexNextImage();
+
+#endif
@@ -22,7 +22,6 @@
 
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
-#include <ESP8266WiFiMulti.h>
 #include <ESP8266mDNS.h>
 #include <ESP8266WebServer.h>
 #include <FS.h>   // Include the SPIFFS library
@@ -30,91 +29,178 @@
 #include <Adafruit_NeoPixel.h>
 #include <string.h>
 #include "LED_Painter.h"
+#include "LineScheduler.h"
+#include "ImageStore.h"
+#include "DrawEngine.h"
+#include "ColorLut.h"
+#include "PageWriter.h"
+#include "ConfigStore.h"
+#include "Metrics.h"
+#include "UploadWriter.h"
+#include "WifiList.h"
+#include "HttpCache.h"
+#include "Crc32.h"
+extern "C" {
+#include "umm_malloc/umm_malloc.h"    // heap block statistics, the core has no API for them yet
+}
 
-ESP8266WiFiMulti wifiMulti;     // Create an instance of the ESP8266WiFiMulti class, called 'wifiMulti'
 
 ESP8266WebServer server(80);    // Create a webserver object that listens for HTTP request on port 80
 
 File fsUploadFile;              // a File object to temporarily store the received file
-
-//Gamma correction Table
-const uint8_t gamma8[] = {
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
-    1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
-    2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
-    5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
-   10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
-   17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
-   25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
-   37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
-   51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
-   69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
-   90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
-  115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
-  144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
-  177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
-  215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255 };
-
-
+FileSink uploadSink(fsUploadFile);
+UploadWriter uploadWriter;
+
+#define UPLOAD_TMP "/upload.tmp"
+#define UPLOAD_BACKUP "/upload.bak"     // the replaced file until the upload is in its place
+#define FILE_SEND_CHUNK 1460            // one TCP segment, on the stack while a file is sent
+// While a drawing runs only requests which fit between two rows are answered,
+// uploads, config stores and larger files get a 503 and are tried again later
+#define BUSY_BODY_MAX 4096              // biggest file sent while drawing, a few TCP segments
+#define BUSY_RETRY_S "5"                // Retry-After of the 503
+const char upload_busy[] = "Drawing, try again later";
+const char *cache_headers[] = { "If-None-Match", "Range" };   // kept by the server for handleFileRead()
+char upload_target[32];         // file the data in UPLOAD_TMP belongs to, empty for none
+struct {
+  uint32_t size;                // bytes of upload_target in UPLOAD_TMP
+  uint32_t crc;
+} upload_resume;
+const char *upload_error;       // why the last upload failed, NULL if it didn't
+bool upload_done;               // the last upload replaced its file
 
 struct Config{
   int no_of_leds;
   int led_pin;
   int line_time;
   int trigger_pin;
+  int cache_size;       // RAM for cached images in bytes, 0 to disable
+  int brightness;       // 0..255
+  int gamma;            // gamma x100
+  int gain_r;           // white balance 0..255 per channel
+  int gain_g;
+  int gain_b;
+  int dither;           // temporal dithering on/off
+  int output;           // OUTPUT_NEOPIXEL, OUTPUT_UART (always on GPIO2) or OUTPUT_PARALLEL (on the segment pins)
+  int stretch;          // lines per image row, 1..STRETCH_MAX
+  int interpolate;      // blend stretched rows into the next one instead of repeating them
+  int resample;         // scaling of images to the strip length, ResampleMode
+  int pattern_rows;     // length of a pattern in rows
+  int color1;           // pattern colours 0xRRGGBB
+  int color2;
+  int pattern_speed;
+  int pattern_size;
+  int playlist_on;      // draw the playlist instead of the image or pattern
+  int playlist_len;
+  int stream;           // StreamProtocol received once the network is up, STREAM_OFF for none
+  int stream_universe;  // first E1.31/Art-Net universe of the strip
   char image_to_draw[32];
+  char pattern[PATTERN_NAME_LEN];         // drawn instead of the image if set
+  char pattern_text[PATTERN_TEXT_LEN];
+  char segments[SEGMENTS_TEXT_LEN];       // strips of OUTPUT_PARALLEL, see parseSegments()
   char wifi_mode[4];
   char sta_ssid[32];
   char sta_pass[64];
   char ap_ssid[32];
   char ap_pass[32];
+  PlaylistEntry playlist[PLAYLIST_MAX];
 };
 
 #define TRIGGER_PIN D2
-
-const char *config_filename = "/config.json"; 
-Config configuration = {60,14,20,TRIGGER_PIN,"/test.bmp","sta","YourSSID","YourPass","LED_PainterAP","ledpainter"};
+#define TRIGGER_DEBOUNCE_MS 200
+#define DRAW_COUNTDOWN_MS 3000      // time to get into position after the trigger
+
+// Bump CONFIG_VERSION with every change of struct Config, the snapshot of
+// an older firmware is then ignored and config.json imported instead
+#define CONFIG_VERSION 3
+// nodes plus the copied keys and strings of a full config, allocated in one
+// block on the heap while importing or exporting (too big for the 4 KB stack)
+#define CONFIG_JSON_SIZE (JSON_OBJECT_SIZE(33) + JSON_ARRAY_SIZE(PLAYLIST_MAX) + PLAYLIST_MAX * JSON_OBJECT_SIZE(5) + 1344)
+
+const char *config_filename = "/config.json";     // import/export, edited or uploaded by the user
+const char *config_snapshot = "/config.bin";      // struct Config as is, read on boot
+bool config_from_snapshot;      // the snapshot was read at boot, not config.json
+uint32_t config_load_us;        // time load_config() took at boot
+uint32_t ready_ms;              // time from power on to the end of setup()
+Config configuration = {60,14,20,TRIGGER_PIN,16384,255,280,255,255,255,0,OUTPUT_NEOPIXEL,1,1,RESAMPLE_BOX,500,0xFFFFFF,0x000000,60,10,0,0,STREAM_OFF,1,"/test.bmp","","LED Painter","","sta","YourSSID","YourPass","LED_PainterAP","ledpainter",{}};
 
 String getContentType(String filename); // convert the file extension to the MIME type
 bool handleFileRead(String path);       // send the right file to the client (if it exists)
+void sendFile(const String& path, const FileIndex::Entry& entry, const String& contentType, bool gz);
 void handleFileUpload();                // upload a new file to the SPIFFS
 void handleFileUploadDialog();
+void finishUpload();
+void handleUploadDone();
+void handleUploadStatus();
 void handleSuccess();
 void handleFileList();
+void handleThumbnail();
 void handleConfig();
 void handleBrowseWifi();
 void handleRoot();
 void handleTrigger();
+void handleStatus();
+void handleMetrics();
+void handleConfigTiming();
+void timed(void (*handler)());
+bool refuseWhileBusy();
 int load_config();
 int write_config();
-int start_sta();
-int start_ap();
-void drawBMP(char *filename);
-
-int start_sta(){
-  wifiMulti.addAP(configuration.sta_ssid, configuration.sta_pass);   // add Wi-Fi networks you want to connect to
-
-    
+int import_config();
+int export_config();
+void start_sta();
+void start_ap();
+void netTick();
+bool startDraw();
+bool startStream(StreamProtocol protocol);
+void handleStream();
+void buildColorLut();
+int parseColor(const String& s);
+void printColor(Print& out, int color);
+void checkTrigger();
+void wifiScanTick();
+uint32_t lineClock();
+uint32_t cycleClock();
+void lineWait(uint32_t us);
+
+LineScheduler lineScheduler(lineClock, lineWait);
+ColorLut colorLut;
+DrawEngine drawEngine(lineScheduler, colorLut);
+
+bool trigger_down = false;      // trigger pin is low
+bool trigger_fired = false;     // this press already started a drawing
+uint32_t trigger_since;         // millis() when the trigger went down
+
+// WiFi, mDNS and the web server come up from loop(), so the trigger works
+// right after reset instead of after the station connect timeout
+enum NetState {
+  NET_CONNECTING,     // station connect running
+  NET_START_AP,       // station failed or AP mode configured
+  NET_SERVICES,       // WiFi is up, mDNS and web server still to start
+  NET_READY
+};
+#define STA_CONNECT_TIMEOUT_MS 11000
+
+NetState net_state;
+uint32_t net_since;             // millis() when the station connect started
+
+// The browse page shows the last scan and asks loop() for a new one when it
+// is older than WIFI_SCAN_TTL_MS. The scan runs in the background and is
+// only started while nothing is drawn.
+#define WIFI_SCAN_TTL_MS 60000
+WifiList wifiList;
+bool wifi_scan_wanted = false;
+bool wifi_scanning = false;
+
+void start_sta(){
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(configuration.sta_ssid, configuration.sta_pass);     // returns at once, netTick() waits for it
+  net_since = millis();
+  net_state = NET_CONNECTING;
   Serial.println("Connecting ...");
-  int i = 0;
-  while (wifiMulti.run() != WL_CONNECTED) { // Wait for the Wi-Fi to connect
-    delay(1000);
-    Serial.print(++i); Serial.print(' ');
-    if(i > 10){
-      Serial.println('\n');
-      Serial.print("Failed to Connect: Timeout ");
-      return -1;
-    }
-  }
-  Serial.println('\n');
-  Serial.print("Connected to ");
-  Serial.println(WiFi.SSID());              // Tell us what network we're connected to
-  Serial.print("IP address:\t");
-  Serial.println(WiFi.localIP());           // Send the IP address of the ESP8266 to the computer
 }
 
-int start_ap(){
+void start_ap(){
+  WiFi.mode(WIFI_AP);
   WiFi.softAP(configuration.ap_ssid, configuration.ap_pass);             // Start the access point
   Serial.print("Access Point \"");
   Serial.print(configuration.ap_ssid);
@@ -122,7 +208,49 @@ int start_ap(){
 
   Serial.print("IP address:\t");
   Serial.println(WiFi.softAPIP());  
+}
 
+void netTick(){
+  switch(net_state){
+    case NET_CONNECTING:
+      if(WiFi.status() == WL_CONNECTED){
+        Serial.print("Connected to ");
+        Serial.println(WiFi.SSID());              // Tell us what network we're connected to
+        Serial.print("IP address:\t");
+        Serial.println(WiFi.localIP());           // Send the IP address of the ESP8266 to the computer
+        net_state = NET_SERVICES;
+      }
+      else if(millis() - net_since > STA_CONNECT_TIMEOUT_MS){
+        Serial.println("Failed to Connect: Timeout ");
+        net_state = NET_START_AP;
+      }
+      break;
+    case NET_START_AP:
+      if(drawEngine.busy())                       // switching the radio mode stalls for a while
+        break;
+      start_ap();
+      net_state = NET_SERVICES;
+      break;
+    case NET_SERVICES:
+      if(drawEngine.busy())
+        break;
+      if (!MDNS.begin("esp8266")) {             // Start the mDNS responder for esp8266.local
+        Serial.println("Error setting up MDNS responder!");
+      }
+      else
+        Serial.println("mDNS responder started");
+      server.collectHeaders(cache_headers, sizeof(cache_headers) / sizeof(cache_headers[0]));
+      server.begin();                           // Actually start the server
+      Serial.print(F("HTTP server started after "));
+      Serial.print(millis());
+      Serial.println(F(" ms"));
+      net_state = NET_READY;
+      if(configuration.stream != STREAM_OFF)
+        startStream((StreamProtocol)configuration.stream);
+      break;
+    case NET_READY:
+      break;
+  }
 }
 
 void setup() {
@@ -135,83 +263,237 @@ void setup() {
   pinMode(configuration.trigger_pin, INPUT_PULLUP);
 
   SPIFFS.begin();                           // Start the SPI Flash Files System
+  uint32_t index_start = micros();
+  indexFiles();                             // every later lookup goes to the index instead of SPIFFS
+  Serial.print(fileIndex.count());
+  Serial.print(F(" files indexed in "));
+  Serial.print(micros() - index_start);
+  Serial.println(F(" us"));
 
   //if no config file found, write config with defaults
-  
-  if(!SPIFFS.exists(config_filename)){
-    write_config();    
-  }
-  else{
-    load_config();
-  }
+  uint32_t config_start = micros();
+  if(load_config() < 0 && !fileIndex.contains(config_filename))
+    write_config();
+  config_load_us = micros() - config_start;
+  Serial.print(F("Config loaded in "));
+  Serial.print(config_load_us);
+  Serial.println(config_from_snapshot ? F(" us from the snapshot") : F(" us from config.json"));
+
+  buildColorLut();
+
+  //have the default image in RAM before the first trigger
+  size_t cached_len;
+  imageCache.setBudget(configuration.cache_size);
+  if(cacheImage(configuration.image_to_draw, &cached_len))
+    Serial.println(F("Image cached"));
+
+  metrics.begin(cycleClock, ESP.getCpuFreqMHz());
 
   //Start AP mode when wifi mode is AP or Trigger-Pin is pressed
   if(!strcmp(configuration.wifi_mode, "sta") && digitalRead(configuration.trigger_pin) ){
-    delay(1000); //wait a second to avoid bounce
-
-    if(start_sta() < 0){
-      start_ap();
-    }    
+    start_sta();
   }
   else{
-    start_ap();  
-  }
-
-  if (!MDNS.begin("esp8266")) {             // Start the mDNS responder for esp8266.local
-    Serial.println("Error setting up MDNS responder!");
+    net_state = NET_START_AP;
+    //a trigger held for the AP fallback doesn't draw
+    trigger_down = trigger_fired = digitalRead(configuration.trigger_pin) == 0;
   }
-  Serial.println("mDNS responder started");
 
   server.on("/upload", HTTP_GET, []() {                 // if the client requests the upload page
-    handleFileUploadDialog();
+    timed(handleFileUploadDialog);
   });
 
   server.on("/list", HTTP_GET, [](){
-      handleFileList();
+      timed(handleFileList);
   });
 
   server.on("/config", HTTP_GET, [](){
-      handleConfig();
+      timed(handleConfig);
   });
 
   server.on("/upload", HTTP_POST,                       // if the client posts to the upload page
-    [](){ server.send(200); },                          // Send status 200 (OK) to tell the client we are ready to receive
-    handleFileUpload                                    // Receive and save the file
+    [](){ timed(handleUploadDone); },                   // Tell the client how the upload went
+    [](){ timed(handleFileUpload); }                    // Receive and save the file
   );
 
+  server.on("/thumb", HTTP_GET, [](){
+    timed(handleThumbnail);
+  });
+  server.on("/upload/status", HTTP_GET, [](){
+    timed(handleUploadStatus);
+  });
+
   server.on("/action", HTTP_GET, [](){
-    handleTrigger();
+    timed(handleTrigger);
+  });
+
+  server.on("/status", HTTP_GET, [](){
+    timed(handleStatus);
   });
 
    server.on("/", HTTP_GET, [](){
-    handleRoot();
+    timed(handleRoot);
+  });
+
+  server.on("/stream", HTTP_GET, [](){
+    timed(handleStream);
+  });
+
+  server.on("/metrics", HTTP_GET, [](){
+    timed(handleMetrics);
+  });
+
+  server.on("/config/timing", HTTP_GET, [](){
+    timed(handleConfigTiming);
   });
 
   server.onNotFound([]() {                              // If the client requests any URI
+    uint32_t start = metrics.start();
     if (!handleFileRead(server.uri()))                  // send it if it exists
       server.send(404, "text/plain", "404: Not Found"); // otherwise, respond with a 404 (Not Found) error
+    metrics.record(METRIC_HANDLER, start);
   });
 
-  server.begin();                           // Actually start the server
-  Serial.println("HTTP server started");
+  ready_ms = millis();
+  Serial.print(F("Ready to draw after "));
+  Serial.print(ready_ms);
+  Serial.println(F(" ms"));
 }
 
 void loop() {
-  server.handleClient();
-  
-  if(digitalRead(configuration.trigger_pin) == 0){
-    delay(200); //make sure not boucing
-    //still pressed
-    if(digitalRead(configuration.trigger_pin) == 0){
-      Serial.println(millis());
-      delay(3000); //just wait 3 seconds until drawing bitmap
-      drawBMP(configuration.image_to_draw);
-      Serial.print("Drawing done ");
-      Serial.println(millis());
+  drawEngine.tick();
+  //only serve clients when it doesn't delay the next row
+  if(drawEngine.canService()){
+    if(net_state == NET_READY){
+      server.handleClient();
+      wifiScanTick();
     }
+    else
+      netTick();
+    //image sizes for /list, one header per pass while nothing is drawn
+    if(!drawEngine.busy())
+      indexNextImage();
+  }
+  checkTrigger();
+}
+
+void wifiScanTick(){
+  int8_t found;
+
+  if(wifi_scanning){
+    found = WiFi.scanComplete();
+    if(found == WIFI_SCAN_RUNNING)
+      return;
+    wifi_scanning = false;
+    if(found < 0){
+      Serial.println(F("WiFi scan failed"));
+      return;
+    }
+    wifiList.clear();
+    for(int8_t i = 0; i < found; i++)
+      wifiList.add(WiFi.SSID(i).c_str(), WiFi.RSSI(i), WiFi.encryptionType(i) == ENC_TYPE_NONE);
+    WiFi.scanDelete();
+    wifiList.done(millis());
+    Serial.print(F("WiFi scan found ")); Serial.println(found);
+    return;
+  }
+  if(wifi_scan_wanted && !drawEngine.busy()){
+    wifi_scan_wanted = false;
+    //returns at once, scanComplete() tells when it is done
+    wifi_scanning = WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+  }
+}
+
+void checkTrigger(){
+  if(digitalRead(configuration.trigger_pin) != 0){
+    trigger_down = false;
+    return;
+  }
+  if(!trigger_down){
+    trigger_down = true;
+    trigger_fired = false;
+    trigger_since = millis();
+    return;
+  }
+  //make sure not boucing, then draw once per press
+  if(!trigger_fired && millis() - trigger_since >= TRIGGER_DEBOUNCE_MS){
+    trigger_fired = true;
+    startDraw();
   }
 }
 
+void buildColorLut(){
+  colorLut.build(constrain(configuration.gamma, 100, 500), constrain(configuration.brightness, 0, 255),
+                 constrain(configuration.gain_r, 0, 255), constrain(configuration.gain_g, 0, 255),
+                 constrain(configuration.gain_b, 0, 255), configuration.dither != 0);
+}
+
+// how long drawing rows takes with the current line time and stretch
+uint32_t drawDuration(uint32_t rows){
+  return rows * configuration.line_time * constrain(configuration.stretch, 1, STRETCH_MAX);
+}
+
+// "#RRGGBB" or "RRGGBB"
+int parseColor(const String& s){
+  const char *p = s.c_str();
+  if(*p == '#') p++;
+  return strtol(p, NULL, 16) & 0xFFFFFF;
+}
+
+void printColor(Print& out, int color){
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%06X", color & 0xFFFFFF);
+  out.print(buf);
+}
+
+// pin of the output, the parallel output gets its segments
+uint8_t outputPin(){
+  StripSegment segments[SEGMENTS_MAX];
+  int8_t count;
+
+  if(configuration.output == OUTPUT_PARALLEL){
+    count = parseSegments(configuration.segments, segments, SEGMENTS_MAX);
+    setStripSegments(segments, count > 0 ? count : 0);
+  }
+  return configuration.output == OUTPUT_UART ? UART_OUTPUT_PIN : configuration.led_pin;
+}
+
+bool startDraw(){
+  static bool first_draw = true;
+  if(first_draw){
+    first_draw = false;
+    Serial.print(F("First draw "));
+    Serial.print(millis());
+    Serial.println(F(" ms after reset"));
+  }
+  uint8_t pin = outputPin();
+  drawEngine.setStretch(constrain(configuration.stretch, 1, STRETCH_MAX), configuration.interpolate != 0);
+  drawEngine.setResample((ResampleMode)constrain(configuration.resample, (int)RESAMPLE_OFF, (int)RESAMPLE_BOX));
+  if(configuration.pattern[0] || configuration.playlist_on){
+    PatternParams params;
+    params.color1 = configuration.color1;
+    params.color2 = configuration.color2;
+    params.speed = configuration.pattern_speed;
+    params.size = constrain(configuration.pattern_size, 1, 1000);
+    strncpy(params.text, configuration.pattern_text, sizeof(params.text));
+    if(configuration.playlist_on && configuration.playlist_len > 0)
+      return drawEngine.startPlaylist(configuration.playlist, configuration.playlist_len, params, configuration.pattern_rows,
+                                      configuration.no_of_leds, pin, (OutputType)configuration.output,
+                                      (uint32_t)configuration.line_time * 1000, DRAW_COUNTDOWN_MS);
+    if(configuration.pattern[0])
+      return drawEngine.startPattern(configuration.pattern, params, configuration.pattern_rows, configuration.no_of_leds, pin,
+                                     (OutputType)configuration.output, (uint32_t)configuration.line_time * 1000, DRAW_COUNTDOWN_MS);
+  }
+  return drawEngine.start(configuration.image_to_draw, configuration.no_of_leds, pin, (OutputType)configuration.output,
+                          (uint32_t)configuration.line_time * 1000, DRAW_COUNTDOWN_MS);
+}
+
+bool startStream(StreamProtocol protocol){
+  uint8_t pin = outputPin();
+  return drawEngine.startStream(protocol, configuration.stream_universe, configuration.no_of_leds, pin,
+                                (OutputType)configuration.output);
+}
+
 String getContentType(String filename) { // convert the file extension to the MIME type
   if (filename.endsWith(".html")) return "text/html";
   else if(filename.endsWith(".htm")) return "text/html";
@@ -230,120 +512,513 @@ String getContentType(String filename) { // convert the file extension to the MI
 }
 
 void handleRoot(){
-    String page = FPSTR(HTTP_HEAD);
-    page.replace("{v}", "LED-Lightpainter");
-    page += FPSTR(HTTP_STYLE);
-    page += FPSTR(HTTP_JS_IMAGE);
-    page += FPSTR(HTTP_HEAD_END);
-    page += F("<h1>LED-Lightpainter</h1><br />");
-    page += F("<a href=\"/config\">Configuration</a><br />");
-    page += F("<a href=\"/upload\">Upload File</a><br />");
-    page += F("<a href=\"/list\">Select Image</a><p />");
-    page += F("<form action=\"/action\" method=\"get\"><button name=\"action\" value=\"trigger\" type=\"submit\">Draw Image</button></form>");
+    PageWriter page(server);
+    page.begin("LED-Lightpainter");
+    page.print(FPSTR(HTTP_STYLE));
+    page.print(FPSTR(HTTP_JS_IMAGE));
+    page.print(FPSTR(HTTP_HEAD_END));
+    page.print(F("<h1>LED-Lightpainter</h1><br />"));
+    page.print(F("<a href=\"/config\">Configuration</a><br />"));
+    page.print(F("<a href=\"/upload\">Upload File</a><br />"));
+    page.print(F("<a href=\"/list\">Select Image</a><p />"));
+    page.print(F("<form action=\"/action\" method=\"get\"><button name=\"action\" value=\"trigger\" type=\"submit\">Draw Image</button></form>"));
 
-    page += FPSTR(HTTP_END);
+    page.print(FPSTR(HTTP_END));
 
-    server.send(200, "text/html", page);
+    page.end();
 
 
 }
 
 void handleTrigger(){
-    String page = FPSTR(HTTP_HEAD);
-    page.replace("{v}", "Trigger");
-    page += FPSTR(HTTP_STYLE);
-    page += FPSTR(HTTP_JS_IMAGE);
-    page += FPSTR(HTTP_HEAD_END);
-    page += F("<h1>LED-Lightpainter</h1><br />");
-    page += F("<a href=\"/\">Back to Index</a><br />");
+    PageWriter page(server);
+    page.begin("Trigger");
+    page.print(FPSTR(HTTP_STYLE));
+    page.print(FPSTR(HTTP_JS_IMAGE));
+    page.print(FPSTR(HTTP_HEAD_END));
+    page.print(F("<h1>LED-Lightpainter</h1><br />"));
+    page.print(F("<a href=\"/\">Back to Index</a><br />"));
     if(server.hasArg("action")){
       if(server.arg("action").equals("trigger")){
-        page += F("Drawing in 3 Seconds<br />");
-        
-        drawBMP(configuration.image_to_draw);
+        if(startDraw())
+          page.print(F("Drawing in 3 Seconds<br />"));
+        else
+          page.print(F("Can't draw the image<br />"));
       }
     }
-    page += FPSTR(HTTP_END);
+    page.print(FPSTR(HTTP_END));
 
-    server.send(200, "text/html", page);
+    page.end();
     
 
 }
 
 
+void handleStatus(){
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject &root = jsonBuffer.createObject();
+  JsonObject &draw = root.createNestedObject("draw");
+  JsonObject &cache = root.createNestedObject("cache");
+  String json;
+
+  draw["state"] = drawEngine.stateName();
+  draw["image"] = drawEngine.filename();
+  draw["row"] = drawEngine.row();
+  draw["rows"] = drawEngine.rows();
+  draw["progress"] = drawEngine.rows() ? drawEngine.row() * 100 / drawEngine.rows() : 0;
+  draw["cached"] = drawEngine.cached();
+
+  cache["hits"] = imageCache.stats().hits;
+  cache["misses"] = imageCache.stats().misses;
+  cache["evictions"] = imageCache.stats().evictions;
+  cache["entries"] = imageCache.entries();
+  cache["used"] = imageCache.used();
+  cache["budget"] = imageCache.budget();
+  root["free_heap"] = ESP.getFreeHeap();
+
+  root.printTo(json);
+  server.send(200, "application/json", json);
+}
+
+// /stream?mode=ddp|e131|artnet starts receiving (until mode=off or a
+// reboot), without mode it only tells the counters of the stream
+void handleStream(){
+  const FrameStream& stream = drawEngine.stream();
+  char json[256];
+
+  if(server.hasArg("mode")){
+    String mode = server.arg("mode");
+    if(drawEngine.state() == DRAW_STREAMING)
+      drawEngine.stop();
+    for(uint8_t i = STREAM_DDP; i <= STREAM_ARTNET; i++){
+      if(mode == FrameStream::name((StreamProtocol)i) && !startStream((StreamProtocol)i)){
+        server.send(409, "text/plain", "409: Can't stream while drawing");
+        return;
+      }
+    }
+  }
+  const FrameStream::Stats& stats = stream.stats();
+  bool active = drawEngine.state() == DRAW_STREAMING;
+  snprintf(json, sizeof(json), "{\"mode\":\"%s\",\"packets\":%u,\"frames\":%u,\"dropped\":%u,\"out_of_order\":%u,"
+           "\"invalid\":%u,\"latency_us\":{\"avg\":%u,\"max\":%u},\"jitter_us\":{\"avg\":%u,\"max\":%u}}",
+           FrameStream::name(active ? stream.protocol() : STREAM_OFF), (unsigned)stats.packets, (unsigned)stats.frames,
+           (unsigned)stats.dropped, (unsigned)stats.out_of_order, (unsigned)stats.invalid,
+           (unsigned)(stats.frames ? stats.total_latency_us / stats.frames : 0), (unsigned)stats.max_latency_us,
+           (unsigned)(stats.frames > 2 ? stats.total_jitter_us / (stats.frames - 2) : 0), (unsigned)stats.max_jitter_us);
+  server.send(200, "application/json", json);
+}
+
+void timed(void (*handler)()){
+  uint32_t start = metrics.start();
+  handler();
+  metrics.record(METRIC_HANDLER, start);
+}
+
+// true (and a 503) while drawing, for requests which would push the next
+// rows past their time: flash writes and long file bodies
+bool refuseWhileBusy(){
+  if(!drawEngine.busy())
+    return false;
+  server.sendHeader("Retry-After", BUSY_RETRY_S);
+  server.send(503, "text/plain", String("503: ") + upload_busy);
+  return true;
+}
+
+static void printUs(Print& out, uint64_t cycles){
+  out.print((double)cycles / metrics.cyclesPerUs(), 1);
+}
+
+static void printGauge(Print& out, const __FlashStringHelper* name, uint32_t value){
+  out.print(F("ledpainter_"));
+  out.print(name);
+  out.print(' ');
+  out.println(value);
+}
+
+// /metrics is Prometheus text, /metrics?format=json the same as JSON. Both are
+// streamed, so a request needs no heap while a drawing runs
+void handleMetrics(){
+  PageWriter page(server);
+  bool json = server.arg("format") == "json";
+  FSInfo fs;
+  uint32_t max_block;
+  uint8_t fragmentation;
+
+  umm_info(NULL, 0);
+  max_block = ummHeapInfo.maxFreeContiguousBlocks * 8;
+  fragmentation = ummHeapInfo.freeBlocks ? 100 - ummHeapInfo.maxFreeContiguousBlocks * 100 / ummHeapInfo.freeBlocks : 0;
+  SPIFFS.info(fs);
+  const LineScheduler::Stats& lines = lineScheduler.stats();
+
+  if(json){
+    page.beginRaw("application/json");
+    page.print(F("{\"timings_us\":{"));
+    for(uint8_t id = 0; id < METRIC_COUNT; id++){
+      const Histogram& h = metrics.histogram((MetricId)id);
+      if(id) page.print(',');
+      page.print('"'); page.print(Metrics::name((MetricId)id)); page.print(F("\":{\"count\":"));
+      page.print(h.count);
+      page.print(F(",\"avg\":")); printUs(page, h.count ? h.sum / h.count : 0);
+      page.print(F(",\"max\":")); printUs(page, h.max);
+      //upper bounds of the buckets, the last one is open
+      page.print(F(",\"le\":["));
+      for(uint8_t i = 0; i < METRIC_BUCKETS - 1; i++){
+        if(i) page.print(',');
+        printUs(page, Histogram::bound(i));
+      }
+      page.print(F("],\"buckets\":["));
+      for(uint8_t i = 0; i < METRIC_BUCKETS; i++){
+        if(i) page.print(',');
+        page.print(h.buckets[i]);
+      }
+      page.print(F("]}"));
+    }
+    page.print(F("},\"lines\":{\"count\":")); page.print(lines.lines);
+    page.print(F(",\"late\":")); page.print(lines.late_lines);
+    page.print(F(",\"max_late_us\":")); page.print(lines.max_late_us);
+    page.print(F("},\"heap\":{\"free\":")); page.print(ESP.getFreeHeap());
+    page.print(F(",\"max_block\":")); page.print(max_block);
+    page.print(F(",\"fragmentation\":")); page.print(fragmentation);
+    page.print(F("},\"spiffs\":{\"total\":")); page.print(fs.totalBytes);
+    page.print(F(",\"used\":")); page.print(fs.usedBytes);
+    page.print(F("}}"));
+    page.end();
+    return;
+  }
+
+  page.beginRaw("text/plain; version=0.0.4");
+  for(uint8_t id = 0; id < METRIC_COUNT; id++){
+    const Histogram& h = metrics.histogram((MetricId)id);
+    const char* name = Metrics::name((MetricId)id);
+    uint32_t cumulative = 0;
+    page.print(F("# TYPE ledpainter_")); page.print(name); page.println(F("_us histogram"));
+    for(uint8_t i = 0; i < METRIC_BUCKETS; i++){
+      cumulative += h.buckets[i];
+      page.print(F("ledpainter_")); page.print(name); page.print(F("_us_bucket{le=\""));
+      if(i < METRIC_BUCKETS - 1)
+        printUs(page, Histogram::bound(i));
+      else
+        page.print(F("+Inf"));
+      page.print(F("\"} ")); page.println(cumulative);
+    }
+    page.print(F("ledpainter_")); page.print(name); page.print(F("_us_sum ")); printUs(page, h.sum); page.println();
+    page.print(F("ledpainter_")); page.print(name); page.print(F("_us_count ")); page.println(h.count);
+    page.print(F("ledpainter_")); page.print(name); page.print(F("_us_max ")); printUs(page, h.max); page.println();
+  }
+  //the line statistics are those of the last drawing
+  printGauge(page, F("lines"), lines.lines);
+  printGauge(page, F("late_lines"), lines.late_lines);
+  printGauge(page, F("max_late_us"), lines.max_late_us);
+  printGauge(page, F("heap_free_bytes"), ESP.getFreeHeap());
+  printGauge(page, F("heap_max_block_bytes"), max_block);
+  printGauge(page, F("heap_fragmentation_percent"), fragmentation);
+  printGauge(page, F("spiffs_total_bytes"), fs.totalBytes);
+  printGauge(page, F("spiffs_used_bytes"), fs.usedBytes);
+  page.end();
+}
+
 bool handleFileRead(String path) { // send the right file to the client (if it exists)
+  const FileIndex::Entry* gz;
   Serial.println("handleFileRead: " + path);
   if (path.endsWith("/")) path += "index.html";          // If a folder is requested, send the index file
   String contentType = getContentType(path);             // Get the MIME type
-  String pathWithGz = path + ".gz";
-  if (SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) { // If the file exists, either as a compressed archive, or normal
-    if (SPIFFS.exists(pathWithGz))                         // If there's a compressed version available
-      path += ".gz";                                         // Use the compressed verion
-    File file = SPIFFS.open(path, "r");                    // Open the file
-    size_t sent = server.streamFile(file, contentType);    // Send it to the client
-
-    
-    file.close();                                          // Close the file again
-    Serial.println(String("\tSent file: ") + path);
-    Serial.println(String("\tSent size: ") + sent);
+  const FileIndex::Entry* entry = fileIndex.findWithGz(path.c_str(), &gz);  // the file and its compressed version in one lookup
+  if (gz) {                                              // If there's a compressed version available
+    entry = gz;
+    path += ".gz";                                       // Use the compressed verion
+  }
+  if (entry) {
+    sendFile(path, *entry, contentType, gz != NULL);
     return true;
-    
   }
   Serial.println(String("\tFile Not Found: ") + path);   // If the file doesn't exist, return false
   return false;
 }
 
+// Sends a file with an ETag of its size and CRC. If the browser has it
+// already (If-None-Match) it gets a 304 without a flash read, a Range
+// request only the asked part. Uploads store the CRC, for other files it is
+// taken while the whole file is sent the first time.
+void sendFile(const String& path, const FileIndex::Entry& entry, const String& contentType, bool gz){
+  char etag[ETAG_LEN];
+  uint8_t buf[FILE_SEND_CHUNK];
+  uint32_t start = 0, len = entry.size, sent = 0, crc = 0;
+  int8_t range = 0;
+  bool hash = !entry.crc_known;
+
+  if(entry.crc_known){
+    formatEtag(etag, entry.size, entry.crc);
+    if(server.hasHeader("If-None-Match") && etagMatches(server.header("If-None-Match").c_str(), etag)){
+      server.sendHeader("ETag", etag);
+      server.sendHeader("Cache-Control", cacheControl(path.c_str()));
+      server.send(304);
+      return;
+    }
+  }
+  if(server.hasHeader("Range"))
+    range = parseRange(server.header("Range").c_str(), entry.size, &start, &len);
+  if(range < 0){
+    server.sendHeader("Content-Range", String("bytes */") + entry.size);
+    server.send(416, "text/plain", "416: Range Not Satisfiable");
+    return;
+  }
+  if(len > BUSY_BODY_MAX && refuseWhileBusy())
+    return;
+  File file = SPIFFS.open(path, "r");                    // Open the file
+  if(!file || !file.seek(start, SeekSet)){
+    server.send(500, "text/plain", "500: couldn't read file");
+    return;
+  }
+
+  if(entry.crc_known)
+    server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", cacheControl(path.c_str()));
+  server.sendHeader("Accept-Ranges", "bytes");
+  if(gz)
+    server.sendHeader("Content-Encoding", "gzip");
+  if(range > 0){
+    server.sendHeader("Content-Range", String("bytes ") + start + "-" + (start + len - 1) + "/" + entry.size);
+    hash = false;
+  }
+  server.setContentLength(len);
+  server.send(range > 0 ? 206 : 200, contentType, "");
+
+  WiFiClient client = server.client();
+  while(sent < len){
+    size_t n = file.read(buf, len - sent < sizeof(buf) ? len - sent : sizeof(buf));
+    if(n == 0)
+      break;
+    if(hash)
+      crc = crc32(buf, n, crc);
+    if(client.write(buf, n) != n)
+      break;
+    sent += n;
+  }
+  file.close();                                          // Close the file again
+  if(hash && sent == len)
+    fileIndex.setCrc(path.c_str(), crc);
+  Serial.println(String("\tSent file: ") + path);
+  Serial.println(String("\tSent size: ") + sent);
+}
+
+// /config/timing reads the config once from the snapshot and once from
+// config.json and tells both times next to those of this boot. The boot
+// without the snapshot takes about ready_ms - snapshot_us + json_us. The
+// configuration in use isn't changed.
+void handleConfigTiming(){
+  PageWriter page(server);
+  Config *saved = (Config *)malloc(sizeof(Config));
+  uint32_t start, snapshot_us, json_us;
+  bool snapshot_ok, json_ok;
+
+  if(!saved){
+    server.send(503, "text/plain", "Not enough memory");
+    return;
+  }
+  memcpy(saved, &configuration, sizeof(Config));
+  start = micros();
+  snapshot_ok = readSnapshot(config_snapshot, CONFIG_VERSION, &configuration, sizeof(configuration));
+  snapshot_us = micros() - start;
+  start = micros();
+  json_ok = import_config() == 0;
+  json_us = micros() - start;
+  memcpy(&configuration, saved, sizeof(Config));
+  free(saved);
+
+  page.beginRaw("application/json");
+  page.print(F("{\"boot\":{\"ready_ms\":")); page.print(ready_ms);
+  page.print(F(",\"config_us\":")); page.print(config_load_us);
+  page.print(F(",\"from\":\"")); page.print(config_from_snapshot ? F("snapshot") : F("json"));
+  page.print(F("\"},\"snapshot_us\":")); if(snapshot_ok) page.print(snapshot_us); else page.print(F("null"));
+  page.print(F(",\"json_us\":")); if(json_ok) page.print(json_us); else page.print(F("null"));
+  page.print('}');
+  page.end();
+}
+
+// Uploads go to UPLOAD_TMP and replace the file only once they are complete,
+// so a dropped connection never leaves a truncated image under its name. A
+// broken upload can be continued: /upload/status?file=/name tells how much
+// arrived, the rest is posted to /upload?offset=n. With size (and crc, hex
+// CRC32 of the whole file) the upload is checked before it replaces the file;
+// posting less than size answers 202 with the offset to continue at.
 void handleFileUpload(){ // upload a new file to the SPIFFS
   HTTPUpload& upload = server.upload();
   if(upload.status == UPLOAD_FILE_START){
     String filename = upload.filename;
     if(!filename.startsWith("/")) filename = "/"+filename;
     Serial.print("handleFileUpload Name: "); Serial.println(filename);
-    fsUploadFile = SPIFFS.open(filename, "w");            // Open the file for writing in SPIFFS (create if it doesn't exist)
-    filename = String();
+    uint32_t offset = server.arg("offset").toInt();
+    upload_error = NULL;
+    if(drawEngine.busy()){
+      //the server reads the whole body in one go, so the answer goes out now
+      //and the connection is closed before the body is read
+      upload_error = upload_busy;
+      WiFiClient client = server.client();
+      client.print(F("HTTP/1.1 503 Service Unavailable\r\nRetry-After: " BUSY_RETRY_S "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+      client.stop();
+      return;
+    }
+    if(offset > 0){
+      //only continues the upload this file was the last of
+      if(filename != upload_target || offset != upload_resume.size){
+        upload_error = "Offset doesn't match the partial upload";
+        return;
+      }
+      fsUploadFile = SPIFFS.open(UPLOAD_TMP, "a");
+    }
+    else{
+      filename.toCharArray(upload_target, sizeof(upload_target));
+      upload_resume.size = upload_resume.crc = 0;
+      fsUploadFile = SPIFFS.open(UPLOAD_TMP, "w");
+    }
+    if(!fsUploadFile || !uploadWriter.begin(&uploadSink, upload_resume.size, upload_resume.crc)){
+      upload_error = "couldn't create file";
+      if(fsUploadFile)
+        fsUploadFile.close();
+    }
   } else if(upload.status == UPLOAD_FILE_WRITE){
-    if(fsUploadFile)
-      fsUploadFile.write(upload.buf, upload.currentSize); // Write the received bytes to the file
-  } else if(upload.status == UPLOAD_FILE_END){
-    if(fsUploadFile) {                                    // If the file was successfully created
-      fsUploadFile.close();                               // Close the file again
-      Serial.print("handleFileUpload Size: "); Serial.println(upload.totalSize);
-      handleSuccess();
-    } else {
-      server.send(500, "text/plain", "500: couldn't create file");
+    if(fsUploadFile && !uploadWriter.write(upload.buf, upload.currentSize)) // Collect the received bytes, written in larger pieces
+      upload_error = "Write failed, flash full?";
+  } else if(upload.status == UPLOAD_FILE_END || upload.status == UPLOAD_FILE_ABORTED){
+    if(!fsUploadFile)
+      return;
+    //whatever arrived is kept for a resume, also if the connection broke
+    if(!uploadWriter.flush() && !upload_error)
+      upload_error = "Write failed, flash full?";
+    fsUploadFile.close();
+    upload_resume.size = uploadWriter.written();
+    upload_resume.crc = uploadWriter.crc();
+    uploadWriter.end();
+    Serial.print("handleFileUpload Size: "); Serial.println(upload_resume.size);
+    if(upload.status == UPLOAD_FILE_END && !upload_error)
+      finishUpload();
+  }
+}
+
+// checks the complete upload and puts it in place of the file
+void finishUpload(){
+  String filename = upload_target;
+  uint32_t crc = upload_resume.crc;
+
+  if(server.hasArg("size")){
+    uint32_t size = server.arg("size").toInt();
+    if(upload_resume.size < size)
+      return;       // more to come, handleUploadDone() tells where to continue
+    if(upload_resume.size > size)
+      upload_error = "Upload is bigger than size";
+  }
+  if(!upload_error && server.hasArg("crc") && strtoul(server.arg("crc").c_str(), NULL, 16) != upload_resume.crc)
+    upload_error = "CRC mismatch";
+  if(upload_error){
+    SPIFFS.remove(UPLOAD_TMP);
+    upload_target[0] = 0;
+    return;
+  }
+
+  if(drawEngine.uses(filename.c_str()))
+    drawEngine.stop();                                    // the file is drawn from right now
+  imageCache.invalidate(filename.c_str());                // the cached copy is outdated now
+  //SPIFFS doesn't rename onto an existing file, the old one is moved aside and
+  //only removed once the upload has taken its name
+  bool replace = fileIndex.contains(filename.c_str());
+  SPIFFS.remove(UPLOAD_BACKUP);
+  if(replace && !SPIFFS.rename(filename, UPLOAD_BACKUP)){
+    upload_error = "couldn't replace file";
+    return;
+  }
+  if(!SPIFFS.rename(UPLOAD_TMP, filename)){
+    upload_error = "couldn't create file";
+    if(replace && !SPIFFS.rename(UPLOAD_BACKUP, filename))
+      Serial.println(F("Failed to restore the old file"));
+    indexFile(filename.c_str());
+    return;
+  }
+  if(replace)
+    SPIFFS.remove(UPLOAD_BACKUP);
+  upload_target[0] = 0;
+  upload_resume.size = upload_resume.crc = 0;
+  if(filename.endsWith(".bmp")){
+    char lpfname[32];
+    //uploads are refused while drawing, should one finish anyway the BMP is
+    //drawn as is, never the frame file of an older upload
+    if(!drawEngine.busy())
+      transcodeToLpf(filename);                           // convert once so drawing only has to stream it
+    else if(lpfFilename(filename.c_str(), lpfname, sizeof(lpfname))){
+      SPIFFS.remove(lpfname);
+      fileIndex.remove(lpfname);
     }
+    //it reads the whole image, while drawing /thumb makes it once the drawing is done
+    if(!drawEngine.busy())
+      makeThumbnail(filename.c_str());                    // small preview for the image list
+    else if(thumbFilename(filename.c_str(), lpfname, sizeof(lpfname))){
+      SPIFFS.remove(lpfname);
+      fileIndex.remove(lpfname);
+    }
+  }
+  else if(filename == config_filename){
+    SPIFFS.remove(config_snapshot);                       // imported on the next boot
+    fileIndex.remove(config_snapshot);
+  }
+  indexFile(filename.c_str());
+  fileIndex.setCrc(filename.c_str(), crc);                // the ETag needs no read of the file
+  upload_done = true;
+}
+
+void handleUploadDone(){
+  if(upload_error == upload_busy){
+    refuseWhileBusy();
+    return;
+  }
+  if(upload_error){
+    server.send(500, "text/plain", String("500: ") + upload_error);
+    return;
+  }
+  if(!upload_done){
+    handleUploadStatus();     // partial upload, 202 with the offset to continue at
+    return;
   }
+  upload_done = false;
+  handleSuccess();
+}
+
+void handleUploadStatus(){
+  char json[96];
+  bool pending = upload_target[0] && (!server.hasArg("file") || server.arg("file") == upload_target);
+
+  snprintf(json, sizeof(json), "{\"file\":\"%s\",\"offset\":%u,\"crc\":\"%08x\"}", pending ? upload_target : "",
+           pending ? (unsigned)upload_resume.size : 0, pending ? (unsigned)upload_resume.crc : 0);
+  server.send(pending ? 202 : 200, "application/json", json);
 }
 
 void handleFileUploadDialog(){
-    String page = FPSTR(HTTP_HEAD);
-    page.replace("{v}", "File Upload");
-    page += FPSTR(HTTP_STYLE);
-    page += FPSTR(HTTP_JS_IMAGE);
-    page += FPSTR(HTTP_HEAD_END);
-    page += F("<h1>File Upload</h1><br />");
-    page += F("<form action=\"/upload\" method=\"POST\" enctype=\"multipart/form-data\">");
-    page += F("<input type=\"file\" name=\"data\">");
-    page += F("<input type=\"submit\" value=\"Upload\">");
-    page += F("</form>");
+    PageWriter page(server);
+    page.begin("File Upload");
+    page.print(FPSTR(HTTP_STYLE));
+    page.print(FPSTR(HTTP_JS_IMAGE));
+    page.print(FPSTR(HTTP_HEAD_END));
+    page.print(F("<h1>File Upload</h1><br />"));
+    page.print(F("<form action=\"/upload\" method=\"POST\" enctype=\"multipart/form-data\">"));
+    page.print(F("<input type=\"file\" name=\"data\">"));
+    page.print(F("<input type=\"submit\" value=\"Upload\">"));
+    page.print(F("</form>"));
     
-    page += FPSTR(HTTP_END);
+    page.print(FPSTR(HTTP_END));
 
-    server.send(200, "text/html", page);
+    page.end();
 
 }
 
 void handleSuccess(){
-  String page = FPSTR(HTTP_HEAD);
-    page.replace("{v}", "Upload Success");
-    page += FPSTR(HTTP_STYLE);
-    page += FPSTR(HTTP_HEAD_END);
+  PageWriter page(server);
+    page.begin("Upload Success");
+    page.print(FPSTR(HTTP_STYLE));
+    page.print(FPSTR(HTTP_HEAD_END));
 
-    page += F("<h1>ESP8266 SPIFFS File Upload Successful</h1>");
-    page += F("<p><a href=\"/\">Home</a></p>");
+    page.print(F("<h1>ESP8266 SPIFFS File Upload Successful</h1>"));
+    page.print(F("<p><a href=\"/\">Home</a></p>"));
 
-    page += FPSTR(HTTP_END);
-    server.send(200, "text/html", page);
+    page.print(FPSTR(HTTP_END));
+    page.end();
 }
 
 const String formatBytes(size_t const& bytes) {            // lesbare Anzeige der Speichergrößen
@@ -352,38 +1027,103 @@ const String formatBytes(size_t const& bytes) {            // lesbare Anzeige de
 
 
 void handleFileList(){
-    FSInfo fs_info;  SPIFFS.info(fs_info);    // Füllt FSInfo Struktur mit Informationen über das Dateisystem
-    Dir dir = SPIFFS.openDir("/");            // Auflistung aller im Spiffs vorhandenen Dateien
-    String page = FPSTR(HTTP_HEAD);
-    int i=0;
-    page.replace("{v}", "List Images");
-    page += FPSTR(HTTP_STYLE);
-    page += FPSTR(HTTP_JS_IMAGE);
-    page += FPSTR(HTTP_HEAD_END);
-    page += F("<form action=\"/config\" method=\"get\">");
-    page += F("<select name=\"image\" size=\"10\" onchange=\"setImage(this)\">");
-    while (dir.next()) {
-        if(!dir.fileName().endsWith(".bmp"))
+    PageWriter page(server);
+
+    if(server.arg("format") == "json"){
+      //all files, for scripts; width and rows are 0 for other files and images not read yet
+      page.beginRaw("application/json");
+      page.print('[');
+      for(uint16_t i = 0; i < fileIndex.count(); i++){
+        const FileIndex::Entry& entry = fileIndex.at(i);
+        if(i) page.print(',');
+        page.print(F("{\"name\":\""));
+        page.print(entry.name);
+        page.print(F("\",\"size\":"));
+        page.print(entry.size);
+        page.print(F(",\"format\":\""));
+        page.print(entry.type == IMAGE_BMP ? F("bmp") : entry.type == IMAGE_LPF ? F("lpf") : F(""));
+        page.print(F("\",\"width\":"));
+        page.print(entry.width);
+        page.print(F(",\"rows\":"));
+        page.print(entry.rows);
+        if(entry.type != IMAGE_NONE){
+          page.print(F(",\"duration_ms\":"));
+          page.print(drawDuration(entry.rows));
+        }
+        if(entry.type == IMAGE_BMP){
+          page.print(F(",\"thumb\":\"/thumb?file="));
+          page.print(entry.name);
+          page.print('"');
+        }
+        page.print('}');
+      }
+      page.print(']');
+      page.end();
+      return;
+    }
+
+    page.begin("List Images");
+    page.print(FPSTR(HTTP_STYLE));
+    page.print(FPSTR(HTTP_JS_IMAGE));
+    page.print(FPSTR(HTTP_HEAD_END));
+    page.print(F("<form action=\"/config\" method=\"get\">"));
+    page.print(F("<select name=\"image\" size=\"10\" onchange=\"setImage(this)\">"));
+    for(uint16_t i = 0; i < fileIndex.count(); i++){
+        const FileIndex::Entry& entry = fileIndex.at(i);
+        size_t len = strlen(entry.name);
+        if(len < 4 || strcmp(entry.name + len - 4, ".bmp"))
           continue;
-        //page += F("<option value=\"") + dir.fileName().substring(1) + "\">" + dir.fileName().substring(1) + F("</option>");
-        page += F("<option value=\"");
-        page += dir.fileName(); //with "/"
-        page += String("\">") + dir.fileName().substring(1) ;
-        page += F("</option>");
+        page.print(F("<option value=\""));
+        page.print(entry.name); //with "/"
+        page.print(F("\">"));
+        page.print(entry.name + 1);
+        if(entry.type != IMAGE_NONE){
+          page.print(F(" ("));
+          page.print(entry.width);
+          page.print(F(" LEDs, "));
+          page.print(entry.rows);
+          page.print(F(" rows, "));
+          page.print(drawDuration(entry.rows) / 1000.0, 1);
+          page.print(F(" s)"));
+        }
+        page.print(F("</option>"));
     }
-    page += F("</select>");
-    page += F("<button type=\"submit\">Select</button></form>");
-    page += F("<br /><img id=\"PrevImg\" src=\"\" />");
+    page.print(F("</select>"));
+    page.print(F("<button type=\"submit\">Select</button></form>"));
+    page.print(F("<br /><img id=\"PrevImg\" src=\"\" />"));
+
+    page.print(FPSTR(HTTP_END));
 
-    page += FPSTR(HTTP_END);
+    page.end();
 
-    server.send(200, "text/html", page);
+}
 
+// Preview of an image for the list, from the upload or made now for images
+// which came with the SPIFFS image. Never made while drawing, it reads the
+// whole image.
+void handleThumbnail(){
+  char thumbname[32];
+  const FileIndex::Entry* entry = NULL;
+  String filename = server.arg("file");
+
+  if(thumbFilename(filename.c_str(), thumbname, sizeof(thumbname)) && fileIndex.contains(filename.c_str())){
+    if(!fileIndex.contains(thumbname) && !drawEngine.busy())
+      makeThumbnail(filename.c_str());
+    entry = fileIndex.find(thumbname);
+  }
+  if(!entry){
+    server.send(404, "text/plain", "404: Not Found");
+    return;
+  }
+  sendFile(thumbname, *entry, "image/bmp", false);
 }
 
 void handleConfig(){
   String filename;    
 
+  //a store writes the flash twice, nothing is changed if it can't be done now
+  if(server.arg("action").equals("store") && refuseWhileBusy())
+    return;
   if(server.args() > 0){
     
     if(server.hasArg("no_LEDs"))
@@ -394,11 +1134,82 @@ void handleConfig(){
       configuration.line_time = server.arg("line_time").toInt();  
     if(server.hasArg("trigger_pin"))
       configuration.led_pin = server.arg("LED_pin").toInt();
+    if(server.hasArg("cache_size")){
+      configuration.cache_size = server.arg("cache_size").toInt();
+      imageCache.setBudget(configuration.cache_size);
+    }
+    if(server.hasArg("output"))
+      configuration.output = constrain(server.arg("output").toInt(), (int)OUTPUT_NEOPIXEL, (int)OUTPUT_PARALLEL);
+    if(server.hasArg("segments")){
+      StripSegment segments[SEGMENTS_MAX];
+      String text = server.arg("segments");
+      text.replace(" ", "");
+      if(parseSegments(text.c_str(), segments, SEGMENTS_MAX) >= 0)
+        text.toCharArray(configuration.segments, sizeof(configuration.segments));
+      else
+        Serial.println(F("Segments not valid"));
+    }
+    if(server.hasArg("stretch"))
+      configuration.stretch = constrain(server.arg("stretch").toInt(), 1, STRETCH_MAX);
+    if(server.hasArg("interpolate"))
+      configuration.interpolate = server.arg("interpolate").toInt() != 0;
+    if(server.hasArg("stream"))
+      configuration.stream = constrain(server.arg("stream").toInt(), (int)STREAM_OFF, (int)STREAM_ARTNET);
+    if(server.hasArg("stream_universe"))
+      configuration.stream_universe = constrain(server.arg("stream_universe").toInt(), 0, 32767);
+    if(server.hasArg("resample"))
+      configuration.resample = constrain(server.arg("resample").toInt(), (int)RESAMPLE_OFF, (int)RESAMPLE_BOX);
+    if(server.hasArg("brightness"))
+      configuration.brightness = server.arg("brightness").toInt();
+    if(server.hasArg("gamma"))
+      configuration.gamma = server.arg("gamma").toFloat() * 100 + 0.5;
+    if(server.hasArg("gain_r"))
+      configuration.gain_r = server.arg("gain_r").toInt();
+    if(server.hasArg("gain_g"))
+      configuration.gain_g = server.arg("gain_g").toInt();
+    if(server.hasArg("gain_b"))
+      configuration.gain_b = server.arg("gain_b").toInt();
+    if(server.hasArg("line_time"))
+      configuration.dither = server.hasArg("dither");     // unchecked boxes are not sent, so look at a field which always is
+    buildColorLut();
     if(server.hasArg("image")){
       filename = server.arg("image");
       if(!filename.startsWith("/")) filename = "/"+filename;
       filename.toCharArray(configuration.image_to_draw,sizeof(configuration.image_to_draw));  
     }
+    if(server.hasArg("pattern"))
+      server.arg("pattern").toCharArray(configuration.pattern, sizeof(configuration.pattern));
+    if(server.hasArg("pattern_rows"))
+      configuration.pattern_rows = server.arg("pattern_rows").toInt();
+    if(server.hasArg("color1"))
+      configuration.color1 = parseColor(server.arg("color1"));
+    if(server.hasArg("color2"))
+      configuration.color2 = parseColor(server.arg("color2"));
+    if(server.hasArg("pattern_speed"))
+      configuration.pattern_speed = server.arg("pattern_speed").toInt();
+    if(server.hasArg("pattern_size"))
+      configuration.pattern_size = server.arg("pattern_size").toInt();
+    if(server.hasArg("pattern_text"))
+      server.arg("pattern_text").toCharArray(configuration.pattern_text, sizeof(configuration.pattern_text));
+    if(server.hasArg("line_time"))
+      configuration.playlist_on = server.hasArg("playlist_on");
+    if(server.hasArg("pl0_image")){
+      //empty rows close the gaps, the list ends at the last named entry
+      configuration.playlist_len = 0;
+      for(uint8_t i = 0; i < PLAYLIST_MAX; i++){
+        String prefix = "pl" + String(i) + "_";
+        String name = server.arg(prefix + "image");
+        name.trim();
+        if(name.length() == 0)
+          continue;
+        PlaylistEntry &entry = configuration.playlist[configuration.playlist_len++];
+        name.toCharArray(entry.name, sizeof(entry.name));
+        entry.line_time = constrain(server.arg(prefix + "time").toInt(), 0, 65535);
+        entry.repeat = constrain(server.arg(prefix + "repeat").toInt(), 1, 255);
+        entry.reverse = server.hasArg(prefix + "reverse");
+        entry.gap = constrain(server.arg(prefix + "gap").toInt(), 0, 65535);
+      }
+    }
     if(server.hasArg("wifi_mode"))
       server.arg("wifi_mode").toCharArray(configuration.wifi_mode,sizeof(configuration.wifi_mode)); 
    
@@ -429,98 +1240,299 @@ void handleConfig(){
       }
     }
       
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Config");
-  page += FPSTR(HTTP_STYLE);
-  page += FPSTR(HTTP_HEAD_END);
-
-  page += F("<h1>LED-Lightpainter Config</h1><br />");
-  page += F("<form method=\"get\">");
-  page += F("LEDs: <input type=\"text\" name=\"no_LEDs\" value=\"");
-  page += configuration.no_of_leds;
-  page += F("\" /><br />");
-  page += F("LED Pin: <input type=\"text\" name=\"LED_pin\" value=\"");
-  page += configuration.led_pin;
-  page += F("\" /><br />");
-  page += F("Line Time: <input type=\"text\" name=\"line_time\" value=\"");
-  page += configuration.line_time;
-  page += F("\" /><br />");
-  page += F("Trigger Pin: <input type=\"text\" name=\"trigger_pin\" value=\"");
-  page += configuration.trigger_pin;
-  page += F("\" /><br />");
-  page += F("Image: <input type=\"text\" name=\"image\" value=\"");
-  page += configuration.image_to_draw;
-  page += F("\" /><p />");
-  page += F("<button type=\"submit\" name=\"action\" value=\"browse_file\">Browse</button><p />");
-
-  page += F("<h2>WiFi</h2><br />");
-
-  page += F("<input class=\"radio\" type=\"radio\" name=\"wifi_mode\" value=\"sta\"");
-  if(!strcmp(configuration.wifi_mode,"sta")) page += F(" checked");
-  page += F("/>Station<br />");
-  page += F("SSID: <input type=\"text\" name=\"sta_ssid\" value=\"");
-  page += configuration.sta_ssid;
-  page += F("\" /><br />");
-  page += F("Password: <input type=\"text\" name=\"sta_pass\" value=\"");
-  page += configuration.sta_pass;
-  page += F("\" /><p />");
-
-  page += F("<button type=\"submit\" name=\"action\" value=\"browse_wifi\">Browse WiFi</button><p />");
-  page += F("<input class=\"radio\" type=\"radio\" name=\"wifi_mode\" value=\"client\"");
-  if(!strcmp(configuration.wifi_mode,"ap")) page += F(" checked");
-  page += F(" />AP<br />");
-  page += F("SSID: <input type=\"text\" name=\"ap_ssid\" value=\"");
-  page += configuration.ap_ssid;
-  page += F("\" /><br />");
-  page += F("Password: <input type=\"text\" name=\"sta_pass\" value=\"");
-  page += configuration.ap_pass;
-  page += F("\" /><p />");
-  page += F("<button type=\"submit\" name=\"action\" value=\"set\">Set Temporary</button><p />");
-  page += F("<button type=\"submit\" name=\"action\" value=\"store\">Store</button>");
-  page += F("</form>");
-  page += F("</div></body></html>");
-
-  page += FPSTR(HTTP_END);
-
-  server.send(200, "text/html", page);
+  PageWriter page(server);
+  page.begin("Config");
+  page.print(FPSTR(HTTP_STYLE));
+  page.print(FPSTR(HTTP_HEAD_END));
+
+  page.print(F("<h1>LED-Lightpainter Config</h1><br />"));
+  page.print(F("<form method=\"get\">"));
+  page.print(F("LEDs: <input type=\"text\" name=\"no_LEDs\" value=\""));
+  page.print(configuration.no_of_leds);
+  page.print(F("\" /><br />"));
+  page.print(F("LED Pin: <input type=\"text\" name=\"LED_pin\" value=\""));
+  page.print(configuration.led_pin);
+  page.print(F("\" /><br />"));
+  page.print(F("Line Time: <input type=\"text\" name=\"line_time\" value=\""));
+  page.print(configuration.line_time);
+  page.print(F("\" /><br />"));
+  page.print(F("<input class=\"radio\" type=\"radio\" name=\"output\" value=\"0\""));
+  if(configuration.output == OUTPUT_NEOPIXEL) page.print(F(" checked"));
+  page.print(F("/>NeoPixel (LED Pin) <input class=\"radio\" type=\"radio\" name=\"output\" value=\"1\""));
+  if(configuration.output == OUTPUT_UART) page.print(F(" checked"));
+  page.print(F("/>UART (GPIO2) <input class=\"radio\" type=\"radio\" name=\"output\" value=\"2\""));
+  if(configuration.output == OUTPUT_PARALLEL) page.print(F(" checked"));
+  page.print(F("/>Parallel Strips<br />"));
+  page.print(F("Strips (pin:first LED:LEDs, r for reversed, e.g. 14:0:72,12:72:72r): <input type=\"text\" name=\"segments\" value=\""));
+  page.print(configuration.segments);
+  page.print(F("\" /><br />"));
+  page.print(F("Stretch (Lines per Row): <input type=\"text\" name=\"stretch\" value=\""));
+  page.print(configuration.stretch);
+  page.print(F("\" /> <input class=\"radio\" type=\"radio\" name=\"interpolate\" value=\"0\""));
+  if(!configuration.interpolate) page.print(F(" checked"));
+  page.print(F("/>Repeat <input class=\"radio\" type=\"radio\" name=\"interpolate\" value=\"1\""));
+  if(configuration.interpolate) page.print(F(" checked"));
+  page.print(F("/>Blend<br />"));
+  page.print(F("Scale to LEDs: <select name=\"resample\">"));
+  static const char* const resample_names[] = { "Off", "Nearest", "Bilinear", "Box" };
+  for(int i = RESAMPLE_OFF; i <= RESAMPLE_BOX; i++){
+    page.print(F("<option value=\""));
+    page.print(i);
+    page.print(configuration.resample == i ? F("\" selected>") : F("\">"));
+    page.print(resample_names[i]);
+    page.print(F("</option>"));
+  }
+  page.print(F("</select><br />"));
+  page.print(F("Trigger Pin: <input type=\"text\" name=\"trigger_pin\" value=\""));
+  page.print(configuration.trigger_pin);
+  page.print(F("\" /><br />"));
+  page.print(F("Image Cache (Bytes): <input type=\"text\" name=\"cache_size\" value=\""));
+  page.print(configuration.cache_size);
+  page.print(F("\" /><br />"));
+  page.print(F("Brightness (0-255): <input type=\"text\" name=\"brightness\" value=\""));
+  page.print(configuration.brightness);
+  page.print(F("\" /><br />"));
+  page.print(F("Gamma: <input type=\"text\" name=\"gamma\" value=\""));
+  page.print(configuration.gamma / 100.0);
+  page.print(F("\" /><br />"));
+  page.print(F("White Balance R/G/B (0-255): <input type=\"text\" name=\"gain_r\" value=\""));
+  page.print(configuration.gain_r);
+  page.print(F("\" /><input type=\"text\" name=\"gain_g\" value=\""));
+  page.print(configuration.gain_g);
+  page.print(F("\" /><input type=\"text\" name=\"gain_b\" value=\""));
+  page.print(configuration.gain_b);
+  page.print(F("\" /><br />"));
+  page.print(F("<input type=\"checkbox\" name=\"dither\" value=\"1\""));
+  if(configuration.dither) page.print(F(" checked"));
+  page.print(F(" />Dithering<br />"));
+  page.print(F("Image: <input type=\"text\" name=\"image\" value=\""));
+  page.print(configuration.image_to_draw);
+  page.print(F("\" /><p />"));
+  page.print(F("<button type=\"submit\" name=\"action\" value=\"browse_file\">Browse</button><p />"));
+  page.print(F("Pattern: <select name=\"pattern\"><option value=\"\">Image</option>"));
+  for(uint8_t i = 0; i < patternCount(); i++){
+    page.print(F("<option"));
+    if(!strcmp(configuration.pattern, patternName(i))) page.print(F(" selected"));
+    page.print(F(">"));
+    page.print(patternName(i));
+    page.print(F("</option>"));
+  }
+  page.print(F("</select><br />"));
+  page.print(F("Pattern Rows: <input type=\"text\" name=\"pattern_rows\" value=\""));
+  page.print(configuration.pattern_rows);
+  page.print(F("\" /><br />"));
+  page.print(F("Colors (RRGGBB): <input type=\"text\" name=\"color1\" value=\""));
+  printColor(page, configuration.color1);
+  page.print(F("\" /><input type=\"text\" name=\"color2\" value=\""));
+  printColor(page, configuration.color2);
+  page.print(F("\" /><br />"));
+  page.print(F("Speed: <input type=\"text\" name=\"pattern_speed\" value=\""));
+  page.print(configuration.pattern_speed);
+  page.print(F("\" /><br />"));
+  page.print(F("Size: <input type=\"text\" name=\"pattern_size\" value=\""));
+  page.print(configuration.pattern_size);
+  page.print(F("\" /><br />"));
+  page.print(F("Text: <input type=\"text\" name=\"pattern_text\" value=\""));
+  page.print(configuration.pattern_text);
+  page.print(F("\" /><p />"));
+
+  page.print(F("<h2>Playlist</h2>"));
+  page.print(F("<input type=\"checkbox\" name=\"playlist_on\" value=\"1\""));
+  if(configuration.playlist_on) page.print(F(" checked"));
+  page.print(F(" />Draw the playlist<br />"));
+  page.print(F("<table><tr><th>Image or pattern</th><th>Line Time</th><th>Repeat</th><th>Reverse</th><th>Gap (ms)</th></tr>"));
+  for(uint8_t i = 0; i < PLAYLIST_MAX; i++){
+    bool used = i < configuration.playlist_len;
+    const PlaylistEntry &entry = configuration.playlist[i];
+    page.print(F("<tr><td><input type=\"text\" name=\"pl"));
+    page.print(i);
+    page.print(F("_image\" value=\""));
+    if(used) page.print(entry.name);
+    page.print(F("\" /></td><td><input type=\"text\" size=\"4\" name=\"pl"));
+    page.print(i);
+    page.print(F("_time\" value=\""));
+    page.print(used ? entry.line_time : 0);
+    page.print(F("\" /></td><td><input type=\"text\" size=\"3\" name=\"pl"));
+    page.print(i);
+    page.print(F("_repeat\" value=\""));
+    page.print(used ? entry.repeat : 1);
+    page.print(F("\" /></td><td><input type=\"checkbox\" value=\"1\" name=\"pl"));
+    page.print(i);
+    page.print(F("_reverse\""));
+    if(used && entry.reverse) page.print(F(" checked"));
+    page.print(F(" /></td><td><input type=\"text\" size=\"5\" name=\"pl"));
+    page.print(i);
+    page.print(F("_gap\" value=\""));
+    page.print(used ? entry.gap : 0);
+    page.print(F("\" /></td></tr>"));
+  }
+  page.print(F("</table>Line Time 0 uses the one above, names without / are patterns<p />"));
+
+  page.print(F("<h2>Live Stream</h2>"));
+  page.print(F("Receive after start: <select name=\"stream\">"));
+  for(uint8_t i = STREAM_OFF; i <= STREAM_ARTNET; i++){
+    page.print(F("<option value=\""));
+    page.print(i);
+    page.print('"');
+    if(configuration.stream == i) page.print(F(" selected"));
+    page.print('>');
+    page.print(FrameStream::name((StreamProtocol)i));
+    page.print(F("</option>"));
+  }
+  page.print(F("</select><br />"));
+  page.print(F("First Universe: <input type=\"text\" name=\"stream_universe\" value=\""));
+  page.print(configuration.stream_universe);
+  page.print(F("\" /><p />"));
+
+  page.print(F("<h2>WiFi</h2><br />"));
+
+  page.print(F("<input class=\"radio\" type=\"radio\" name=\"wifi_mode\" value=\"sta\""));
+  if(!strcmp(configuration.wifi_mode,"sta")) page.print(F(" checked"));
+  page.print(F("/>Station<br />"));
+  page.print(F("SSID: <input type=\"text\" name=\"sta_ssid\" value=\""));
+  page.print(configuration.sta_ssid);
+  page.print(F("\" /><br />"));
+  page.print(F("Password: <input type=\"text\" name=\"sta_pass\" value=\""));
+  page.print(configuration.sta_pass);
+  page.print(F("\" /><p />"));
+
+  page.print(F("<button type=\"submit\" name=\"action\" value=\"browse_wifi\">Browse WiFi</button><p />"));
+  page.print(F("<input class=\"radio\" type=\"radio\" name=\"wifi_mode\" value=\"client\""));
+  if(!strcmp(configuration.wifi_mode,"ap")) page.print(F(" checked"));
+  page.print(F(" />AP<br />"));
+  page.print(F("SSID: <input type=\"text\" name=\"ap_ssid\" value=\""));
+  page.print(configuration.ap_ssid);
+  page.print(F("\" /><br />"));
+  page.print(F("Password: <input type=\"text\" name=\"sta_pass\" value=\""));
+  page.print(configuration.ap_pass);
+  page.print(F("\" /><p />"));
+  page.print(F("<button type=\"submit\" name=\"action\" value=\"set\">Set Temporary</button><p />"));
+  page.print(F("<button type=\"submit\" name=\"action\" value=\"store\">Store</button>"));
+  page.print(F("</form>"));
+
+  page.print(FPSTR(HTTP_END));
+
+  page.end();
 
 }
 
 void handleBrowseWifi(){
-  int numberOfNetworks = WiFi.scanNetworks();
+  uint32_t now = millis();
+  bool scanning;
+
+  if(server.hasArg("refresh") || !wifiList.fresh(now, WIFI_SCAN_TTL_MS))
+    wifi_scan_wanted = true;
+  scanning = wifi_scan_wanted || wifi_scanning;
+
+  PageWriter page(server);
+  page.begin("Browse Wifi");
+  page.print(FPSTR(HTTP_STYLE));
+  //reload without asking again until the scan is done
+  if(scanning)
+    page.print(F("<meta http-equiv=\"refresh\" content=\"3;url=/config?action=browse_wifi\">"));
+  page.print(FPSTR(HTTP_HEAD_END));
+
+  if(scanning && drawEngine.busy())
+    page.print(F("Scan starts when the drawing is done<br />"));
+  else if(scanning)
+    page.print(F("Scanning...<br />"));
+  if(wifiList.valid()){
+    page.print(F("Scanned "));
+    page.print(wifiList.age(now) / 1000);
+    page.print(F(" s ago<br />"));
+  }
 
-  String page = FPSTR(HTTP_HEAD);
-  page.replace("{v}", "Browse Wifi");
-  page += FPSTR(HTTP_STYLE);
-  page += FPSTR(HTTP_HEAD_END);
+  page.print(F("<form action=\"/config\" method=\"get\">"));
+  page.print(F("<select name=\"sta_ssid\" size=\"10\">"));
+  for(uint8_t i = 0; i < wifiList.count(); i++){
+    const WifiList::Network& net = wifiList.at(i);
+    page.print(F("<option value=\""));
+    page.print(net.ssid);
+    page.print(F("\">"));
+    page.print(net.ssid);
+    page.print(F(" ("));
+    page.print((int)net.rssi);
+    page.print(net.open ? F(" dBm, open)") : F(" dBm)"));
+    page.print(F("</option>"));
+  }
+  page.print(F("</select>"));
+  page.print(F("<button type=\"submit\">Select</button></form>"));
+  page.print(F("<a href=\"/config?action=browse_wifi&amp;refresh=1\">Refresh</a>"));
+  page.print(FPSTR(HTTP_END));
 
-  page += F("<form action=\"/config\" method=\"get\">");
-  page += F("<select name=\"sta_ssid\" size=\"10\">");
-  for(int i =0; i<numberOfNetworks; i++){
-    page += F("<option value=\"");
-    page += WiFi.SSID(i);
-    page += String("\">") + WiFi.SSID(i) ;
-    page += F("</option>");
+  page.end();
 
+}
+
+int write_config(){
+  if(!writeSnapshot(config_snapshot, CONFIG_VERSION, &configuration, sizeof(configuration))){
+    Serial.println(F("Failed to write config snapshot"));
+    return -1;
   }
-  page += F("</select>");
-  page += F("<button type=\"submit\">Select</button></form>");
-  page += FPSTR(HTTP_END);
+  indexFile(config_snapshot);
+  return export_config();
+}
 
-  server.send(200, "text/html", page);
+int load_config(){
+  config_from_snapshot = readSnapshot(config_snapshot, CONFIG_VERSION, &configuration, sizeof(configuration));
+  if(config_from_snapshot){
+    configuration.playlist_len = constrain(configuration.playlist_len, 0, PLAYLIST_MAX);
+    return 0;
+  }
+  //first boot of this firmware or a new config.json was uploaded
+  if(import_config() < 0)
+    return -1;
+  if(writeSnapshot(config_snapshot, CONFIG_VERSION, &configuration, sizeof(configuration)))
+    indexFile(config_snapshot);
+  return 0;
+}
 
+//copies a JSON string, always terminated and empty for missing keys
+static void copyString(char *dst, const char *src, size_t size){
+  strncpy(dst, src ? src : "", size - 1);
+  dst[size - 1] = 0;
 }
 
-int write_config(){
-  DynamicJsonBuffer jsonBuffer;
+int export_config(){
+  DynamicJsonBuffer jsonBuffer(CONFIG_JSON_SIZE);
   JsonObject &root = jsonBuffer.createObject();
-  File file = SPIFFS.open(config_filename, "w");
 
   root["no_LEDs"] = configuration.no_of_leds;
   root["LED_pin"] = configuration.led_pin;
   root["line_time"] = configuration.line_time;
   root["trigger_pin"] = configuration.trigger_pin;
+  root["cache_size"] = configuration.cache_size;
+  root["brightness"] = configuration.brightness;
+  root["gamma"] = configuration.gamma;
+  root["gain_r"] = configuration.gain_r;
+  root["gain_g"] = configuration.gain_g;
+  root["gain_b"] = configuration.gain_b;
+  root["dither"] = configuration.dither;
+  root["output"] = configuration.output;
+  root["segments"] = configuration.segments;
+  root["stretch"] = configuration.stretch;
+  root["interpolate"] = configuration.interpolate;
+  root["resample"] = configuration.resample;
   root["image"] = configuration.image_to_draw;
+  root["pattern"] = configuration.pattern;
+  root["pattern_rows"] = configuration.pattern_rows;
+  root["color1"] = configuration.color1;
+  root["color2"] = configuration.color2;
+  root["pattern_speed"] = configuration.pattern_speed;
+  root["pattern_size"] = configuration.pattern_size;
+  root["pattern_text"] = configuration.pattern_text;
+  root["stream"] = configuration.stream;
+  root["stream_universe"] = configuration.stream_universe;
+  root["playlist_on"] = configuration.playlist_on;
+  JsonArray &list = root.createNestedArray("playlist");
+  for(int i = 0; i < configuration.playlist_len; i++){
+    JsonObject &entry = list.createNestedObject();
+    entry["image"] = configuration.playlist[i].name;
+    entry["line_time"] = configuration.playlist[i].line_time;
+    entry["repeat"] = configuration.playlist[i].repeat;
+    entry["reverse"] = configuration.playlist[i].reverse;
+    entry["gap"] = configuration.playlist[i].gap;
+  }
 
   root["wifi_mode"] = configuration.wifi_mode;
   
@@ -529,137 +1541,114 @@ int write_config(){
   root["ap_ssid"] = configuration.ap_ssid;
   root["ap_pass"] = configuration.ap_pass;
 
+  File file = SPIFFS.open(config_filename, "w");
+  if(!file)
+    return -1;
   if (root.printTo(file) == 0) {
     Serial.println(F("Failed to write to file"));
     file.close();
+    indexFile(config_filename);
     return -1;
   }
   file.close();
+  indexFile(config_filename);
   return 0;
 }
 
-int load_config(){
-    DynamicJsonBuffer jsonBuffer;
+int import_config(){
+    DynamicJsonBuffer jsonBuffer(CONFIG_JSON_SIZE);
     File file = SPIFFS.open(config_filename, "r");
-    JsonObject &root = jsonBuffer.parseObject(file);;
-        
+    if(!file)
+      return -1;
+    JsonObject &root = jsonBuffer.parseObject(file);
+    file.close();
+    if(!root.success()){
+      Serial.println(F("Failed to parse config"));
+      return -1;
+    }
+
     configuration.no_of_leds = root["no_LEDs"];
     configuration.led_pin = root["LED_pin"];
     configuration.line_time = root["line_time"];
     configuration.trigger_pin = root["trigger_pin"];
-    strncpy(configuration.image_to_draw, root["image"], sizeof(configuration.image_to_draw));
-    strncpy(configuration.wifi_mode,root["wifi_mode"],sizeof(configuration.wifi_mode));
+    if(root.containsKey("cache_size"))
+      configuration.cache_size = root["cache_size"];
+    if(root.containsKey("brightness"))
+      configuration.brightness = root["brightness"];
+    if(root.containsKey("gamma"))
+      configuration.gamma = root["gamma"];
+    if(root.containsKey("gain_r"))
+      configuration.gain_r = root["gain_r"];
+    if(root.containsKey("gain_g"))
+      configuration.gain_g = root["gain_g"];
+    if(root.containsKey("gain_b"))
+      configuration.gain_b = root["gain_b"];
+    if(root.containsKey("dither"))
+      configuration.dither = root["dither"];
+    if(root.containsKey("output"))
+      configuration.output = root["output"];
+    if(root.containsKey("segments"))
+      copyString(configuration.segments, root["segments"], sizeof(configuration.segments));
+    if(root.containsKey("stretch"))
+      configuration.stretch = root["stretch"];
+    if(root.containsKey("interpolate"))
+      configuration.interpolate = root["interpolate"];
+    if(root.containsKey("resample"))
+      configuration.resample = root["resample"];
+    copyString(configuration.image_to_draw, root["image"], sizeof(configuration.image_to_draw));
+    if(root.containsKey("pattern"))
+      copyString(configuration.pattern, root["pattern"], sizeof(configuration.pattern));
+    if(root.containsKey("pattern_rows"))
+      configuration.pattern_rows = root["pattern_rows"];
+    if(root.containsKey("color1"))
+      configuration.color1 = root["color1"];
+    if(root.containsKey("color2"))
+      configuration.color2 = root["color2"];
+    if(root.containsKey("pattern_speed"))
+      configuration.pattern_speed = root["pattern_speed"];
+    if(root.containsKey("pattern_size"))
+      configuration.pattern_size = root["pattern_size"];
+    if(root.containsKey("pattern_text"))
+      copyString(configuration.pattern_text, root["pattern_text"], sizeof(configuration.pattern_text));
+    if(root.containsKey("stream"))
+      configuration.stream = root["stream"];
+    if(root.containsKey("stream_universe"))
+      configuration.stream_universe = root["stream_universe"];
+    if(root.containsKey("playlist_on"))
+      configuration.playlist_on = root["playlist_on"];
+    if(root.containsKey("playlist")){
+      JsonArray &list = root["playlist"];
+      configuration.playlist_len = 0;
+      for(size_t i = 0; i < list.size() && i < PLAYLIST_MAX; i++){
+        JsonObject &item = list.get<JsonObject&>(i);
+        PlaylistEntry &entry = configuration.playlist[configuration.playlist_len++];
+        copyString(entry.name, item["image"], sizeof(entry.name));
+        entry.line_time = item["line_time"];
+        entry.repeat = item.containsKey("repeat") ? (uint8_t)item["repeat"] : 1;
+        entry.reverse = item["reverse"];
+        entry.gap = item["gap"];
+      }
+    }
+    copyString(configuration.wifi_mode, root["wifi_mode"], sizeof(configuration.wifi_mode));
     
-    strncpy(configuration.sta_ssid, root["sta_ssid"], sizeof(configuration.sta_ssid));
-    strncpy(configuration.sta_pass, root["sta_pass"], sizeof(configuration.sta_pass));
-    strncpy(configuration.ap_ssid, root["ap_ssid"], sizeof(configuration.ap_ssid));
-    strncpy(configuration.ap_pass, root["ap_pass"], sizeof(configuration.ap_pass));
-    file.close();
+    copyString(configuration.sta_ssid, root["sta_ssid"], sizeof(configuration.sta_ssid));
+    copyString(configuration.sta_pass, root["sta_pass"], sizeof(configuration.sta_pass));
+    copyString(configuration.ap_ssid, root["ap_ssid"], sizeof(configuration.ap_ssid));
+    copyString(configuration.ap_pass, root["ap_pass"], sizeof(configuration.ap_pass));
     return 0;
 }
 
-uint16_t read16(File& f) {
-  uint16_t result;
-  ((uint8_t *)&result)[0] = f.read(); // LSB
-  ((uint8_t *)&result)[1] = f.read(); // MSB
-  return result;
-}
-
-uint32_t read32(File& f) {
-  uint32_t result;
-  ((uint8_t *)&result)[0] = f.read(); // LSB
-  ((uint8_t *)&result)[1] = f.read();
-  ((uint8_t *)&result)[2] = f.read();
-  ((uint8_t *)&result)[3] = f.read(); // MSB
-  return result;
-}
-
-void drawBMP(char *filename) {
-  File     bmpFile;
-  int16_t  bmpWidth, bmpHeight;   // Image W+H in pixels
-  //uint8_t  bmpDepth;            // Bit depth (must be 24) but we dont use this
-  uint32_t bmpImageoffset;        // Start address of image data in file
-  uint32_t rowSize;               // Not always = bmpWidth; may have padding
-  //uint8_t  sdbuffer[3 * BUFF_SIZE];    // SD read pixel buffer (8 bits each R+G+B per pixel)
-  uint8_t * sdbuffer = (uint8_t *)malloc(configuration.no_of_leds *3);
-  boolean  goodBmp = false;            // Flag set to true on valid header parse
-  int16_t  w, h, row, col,i;             // to store width, height, row and column
-  //uint8_t  r, g, b;   // brg encoding line concatenated for speed so not used
-  uint8_t rotation;     // to restore rotation
-  uint8_t  tft_ptr = 0;  // buffer pointer
-
-  
-
-  SPIFFS.begin();
-  // Check file exists and open it
-  if ((bmpFile = SPIFFS.open(filename, "r")) == NULL) {
-    Serial.println(F("File not found")); // Can comment out if not needed
-    free(sdbuffer);
-    return;
-  }
-  pinMode(configuration.led_pin, OUTPUT);
+uint32_t lineClock(){
+  return micros();
+}
 
-  Adafruit_NeoPixel pixels = Adafruit_NeoPixel(configuration.no_of_leds, configuration.led_pin, NEO_GRB + NEO_KHZ800);
-  
+uint32_t cycleClock(){
+  return ESP.getCycleCount();
+}
 
-  // Parse BMP header to get the information we need
-  if (read16(bmpFile) == 0x4D42) { // BMP file start signature check
-    read32(bmpFile);       // Dummy read to throw away and move on
-    read32(bmpFile);       // Read & ignore creator bytes
-    bmpImageoffset = read32(bmpFile); // Start of image data
-    read32(bmpFile);       // Dummy read to throw away and move on
-    bmpWidth  = read32(bmpFile);  // Image width
-    bmpHeight = read32(bmpFile);  // Image height
-
-    //if (read16(bmpFile) == 1) { // Number of image planes -- must be '1'
-    // Only proceed if we pass a bitmap file check
-    if ((read16(bmpFile) == 1) && (read16(bmpFile) == 24) && (read32(bmpFile) == 0)) { // Must be depth 24 and 0 (uncompressed format)
-      //goodBmp = true; // Supported BMP format -- proceed!
-      // BMP rows are padded (if needed) to 4-byte boundary
-      rowSize = (bmpWidth * 3 + 3) & ~3;
-      // Crop area to be loaded
-      w = bmpWidth;
-      if(w > configuration.no_of_leds){
-        Serial.println(F("Error Image is bigger than LED no"));
-        pinMode(configuration.led_pin, INPUT);
-        free(sdbuffer);
-        bmpFile.close();
-        return;
-      }
-      h = bmpHeight;
-      Serial.println(w);
-      Serial.println(h);
-      
-      for (uint32_t pos = bmpImageoffset; pos < bmpImageoffset + h * rowSize ; pos += rowSize) {
-        if (bmpFile.position() != pos) {
-          bmpFile.seek(pos,SeekSet);
-          bmpFile.read(sdbuffer, configuration.no_of_leds *3);
-        }
-        
-        uint16_t buffer_pos=0;
-          for(i = 0; i < w; i++) {
-            
-            pixels.setPixelColor(i, gamma8[sdbuffer[buffer_pos+2]], gamma8[sdbuffer[buffer_pos+1]], gamma8[sdbuffer[buffer_pos]]);
-            
-            buffer_pos +=3;
-          }
-          
-           pixels.show();
-          
-          delay(configuration.line_time);
-        }
-      }
-      
-    }
-  
-  bmpFile.close();
-  
-  //Clear pixels
-  pixels.clear();
-  pixels.show();          
-
-  //switch pin back to input
-  pinMode(configuration.led_pin, INPUT);
-  free(sdbuffer);
-  return;
- }
\ No newline at end of file
+void lineWait(uint32_t us){
+  if(us > 2000)
+    delay((us - 1000) / 1000);    // coarse part with delay() so WiFi keeps running
+  else
+    delayMicroseconds(us);
+}
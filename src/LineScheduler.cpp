@@ -0,0 +1,75 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include <string.h>
+#include "LineScheduler.h"
+
+LineScheduler::LineScheduler(ClockFunc clock, WaitFunc wait)
+  : _clock(clock), _wait(wait), _period(0), _start(0), _deadline(0) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void LineScheduler::start(uint32_t period_us){
+  memset(&_stats, 0, sizeof(_stats));
+  _period = period_us;
+  _start = _clock();
+  _deadline = _start;
+}
+
+uint32_t LineScheduler::waitForLine(){
+  int32_t remaining;
+  uint32_t now;
+
+  // signed difference so the micros() overflow after ~71 minutes doesn't hurt
+  while((remaining = (int32_t)(_deadline - _clock())) > 0){
+    _wait(remaining);
+  }
+
+  now = _clock();
+  uint32_t late = now - _deadline;
+
+  _stats.lines++;
+  _stats.total_late_us += late;
+  if(late > _stats.max_late_us) _stats.max_late_us = late;
+  if(late > LINE_LATE_TOLERANCE_US) _stats.late_lines++;
+
+  if(late >= _period){
+    // a whole line behind: catching up would show a burst of short lines, so restart from here
+    _deadline = now + _period;
+    _stats.resyncs++;
+  }
+  else{
+    _deadline += _period;   // absolute deadline, the lateness is taken out of the next period
+  }
+  return late;
+}
+
+void LineScheduler::setPeriod(uint32_t period_us){
+  _deadline += period_us - _period;
+  _period = period_us;
+}
+
+uint32_t LineScheduler::elapsed() const{
+  return _clock() - _start;
+}
+
+int32_t LineScheduler::untilNextLine() const{
+  return (int32_t)(_deadline - _clock());
+}
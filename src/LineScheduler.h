@@ -0,0 +1,47 @@
+#ifndef LINE_SCHEDULER_H
+#define LINE_SCHEDULER_H
+
+#include <stdint.h>
+
+// Lines finishing later than this are counted as late in the statistics
+#define LINE_LATE_TOLERANCE_US 50
+
+// Paces the strip output on absolute deadlines instead of a fixed delay after
+// each line. The time spent reading and converting a row is therefore taken
+// out of the line period, and small overruns are caught up by the next lines.
+// Clock and wait are passed in so the scheduler also runs with a fake clock.
+class LineScheduler {
+  public:
+    typedef uint32_t (*ClockFunc)();          // free running microsecond counter
+    typedef void (*WaitFunc)(uint32_t us);    // blocks for (at most) us microseconds
+
+    struct Stats {
+      uint32_t lines;           // number of line edges
+      uint32_t late_lines;      // edges later than LINE_LATE_TOLERANCE_US
+      uint32_t max_late_us;     // worst lateness
+      uint32_t total_late_us;   // sum of lateness, for the average
+      uint32_t resyncs;         // schedule was more than one period behind and restarted
+    };
+
+    LineScheduler(ClockFunc clock, WaitFunc wait);
+
+    void start(uint32_t period_us);   // first edge is now
+    uint32_t waitForLine();           // wait for the next edge, returns lateness in us
+    void setPeriod(uint32_t period_us);  // from the last edge on, the next one moves accordingly
+    uint32_t elapsed() const;         // us since start()
+    uint32_t now() const { return _clock(); }
+    int32_t untilNextLine() const;    // us left until the next edge, negative when already late
+
+    const Stats& stats() const { return _stats; }
+    uint32_t period() const { return _period; }
+
+  private:
+    ClockFunc _clock;
+    WaitFunc _wait;
+    uint32_t _period;
+    uint32_t _start;
+    uint32_t _deadline;
+    Stats _stats;
+};
+
+#endif
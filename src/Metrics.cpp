@@ -0,0 +1,60 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <string.h>
+#include "Metrics.h"
+
+Metrics metrics;
+
+void Histogram::add(uint32_t cycles){
+  uint8_t i = 0;
+
+  count++;
+  sum += cycles;
+  if(cycles > max)
+    max = cycles;
+  //bucket by the highest set bit, no division
+  if(cycles >> METRIC_FIRST_SHIFT){
+    i = 32 - __builtin_clz(cycles) - METRIC_FIRST_SHIFT;
+    if(i > METRIC_BUCKETS - 1)
+      i = METRIC_BUCKETS - 1;
+  }
+  buckets[i]++;
+}
+
+Metrics::Metrics() : _cycles(0), _cycles_per_us(1) {
+  reset();
+}
+
+void Metrics::begin(CycleFunc cycles, uint32_t cycles_per_us){
+  _cycles = cycles;
+  _cycles_per_us = cycles_per_us ? cycles_per_us : 1;
+  reset();
+}
+
+void Metrics::reset(){
+  memset(_hist, 0, sizeof(_hist));
+}
+
+const char* Metrics::name(MetricId id){
+  static const char* const names[METRIC_COUNT] = {"header", "row_read", "convert", "show", "wait", "handler"};
+  return id < METRIC_COUNT ? names[id] : "";
+}
@@ -0,0 +1,61 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#define METRIC_BUCKETS 20       // powers of two of the cycle count, the last one takes the rest
+#define METRIC_FIRST_SHIFT 7    // first bucket is below 2^7 cycles (1.6us at 80MHz)
+
+enum MetricId {
+  METRIC_HEADER,        // opening an image and parsing its header
+  METRIC_ROW_READ,      // reading (and scaling) a row
+  METRIC_CONVERT,       // colour table or blend
+  METRIC_SHOW,          // pushing a row to the strip
+  METRIC_WAIT,          // waiting for the line edge
+  METRIC_HANDLER,       // a web request
+  METRIC_COUNT
+};
+
+// Durations in cycles, counted into fixed power of two buckets so adding a
+// sample is a few instructions and needs no memory
+struct Histogram {
+  uint32_t count;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[METRIC_BUCKETS];
+
+  void add(uint32_t cycles);
+  // upper bound of bucket i in cycles, 0 for the last (unbounded) one
+  static uint32_t bound(uint8_t i) { return i < METRIC_BUCKETS - 1 ? 1UL << (i + METRIC_FIRST_SHIFT) : 0; }
+};
+
+// Hot path timing of the drawing and the web server. The counter is passed
+// in like the clock of the LineScheduler, on the ESP it is the CPU cycle
+// counter. Until begin() nothing is recorded.
+class Metrics {
+  public:
+    typedef uint32_t (*CycleFunc)();
+
+    Metrics();
+    void begin(CycleFunc cycles, uint32_t cycles_per_us);
+
+    uint32_t start() const { return _cycles ? _cycles() : 0; }
+    void record(MetricId id, uint32_t start) {
+      if(_cycles)
+        _hist[id].add(_cycles() - start);
+    }
+    void reset();
+
+    const Histogram& histogram(MetricId id) const { return _hist[id]; }
+    uint32_t cyclesPerUs() const { return _cycles_per_us; }
+    static const char* name(MetricId id);
+
+  private:
+    CycleFunc _cycles;
+    uint32_t _cycles_per_us;
+    Histogram _hist[METRIC_COUNT];
+};
+
+extern Metrics metrics;
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include "PageWriter.h"
+#include "LED_Painter.h"
+
+PageWriter::PageWriter(ESP8266WebServer& server) : _server(server), _len(0), _open(false) {
+}
+
+PageWriter::~PageWriter(){
+  end();
+}
+
+void PageWriter::begin(const char *title, int code){
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);   // no Content-Length, the length isn't known up front
+  _server.send(code, "text/html", "");
+  _client = _server.client();
+  _open = true;
+  printTemplate(HTTP_HEAD, title);
+}
+
+void PageWriter::beginRaw(const char *content_type, int code){
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server.send(code, content_type, "");
+  _client = _server.client();
+  _open = true;
+}
+
+void PageWriter::end(){
+  if(!_open)
+    return;
+  //nothing marks the end, the server closes the connection after the handler
+  flush();
+  _open = false;
+}
+
+void PageWriter::printTemplate(PGM_P tmpl, const char *value){
+  char c;
+  while((c = pgm_read_byte(tmpl)) != 0){
+    if(c == '{' && pgm_read_byte(tmpl + 1) == 'v' && pgm_read_byte(tmpl + 2) == '}'){
+      print(value);
+      tmpl += 3;
+      continue;
+    }
+    write((uint8_t)c);
+    tmpl++;
+  }
+}
+
+size_t PageWriter::write(uint8_t c){
+  if(_len == PAGE_WRITER_BUFFER)
+    flush();
+  _buf[_len++] = c;
+  return 1;
+}
+
+size_t PageWriter::write(const uint8_t *buffer, size_t size){
+  size_t left = size;
+  while(left > 0){
+    size_t n = PAGE_WRITER_BUFFER - _len;
+    if(n > left) n = left;
+    memcpy(_buf + _len, buffer, n);
+    _len += n;
+    buffer += n;
+    left -= n;
+    if(_len == PAGE_WRITER_BUFFER)
+      flush();
+  }
+  return size;
+}
+
+void PageWriter::flush(){
+  //sendContent() would copy every piece into a String first. A client
+  //which is gone gets nothing more, what is printed after is dropped
+  if(_len > 0 && _open && _client.write(_buf, _len) != _len)
+    _open = false;
+  _len = 0;
+}
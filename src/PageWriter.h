@@ -0,0 +1,45 @@
+#ifndef PAGE_WRITER_H
+#define PAGE_WRITER_H
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+#define PAGE_WRITER_BUFFER 256
+
+// Streams a page to the client in pieces of at most PAGE_WRITER_BUFFER bytes
+// instead of building it in a String first. Everything printed (including
+// F()/FPSTR() strings) goes through a fixed buffer which is written straight
+// to the client, so the heap needed for a page doesn't depend on how many
+// files or networks are listed (see tools/pagesim.cpp). The response has no
+// Content-Length, core 2.3.0 sends it unchunked and it ends when the
+// connection is closed after the handler.
+class PageWriter : public Print {
+  public:
+    PageWriter(ESP8266WebServer& server);
+    ~PageWriter();
+
+    // sends the response header and HTTP_HEAD with {v} set to title
+    void begin(const char *title, int code = 200);
+    // sends only the response header, for other content than HTML pages
+    void beginRaw(const char *content_type, int code = 200);
+    // sends what is left and ends the response
+    void end();
+
+    // prints a PROGMEM template with every {v} replaced by value
+    void printTemplate(PGM_P tmpl, const char *value);
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+  private:
+    void flush();
+
+    ESP8266WebServer& _server;
+    WiFiClient _client;
+    uint8_t _buf[PAGE_WRITER_BUFFER];
+    size_t _len;
+    bool _open;
+};
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <string.h>
+#include "Pattern.h"
+
+#ifdef ARDUINO
+#include <pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#endif
+
+// 8 bit colour helpers, all in GRB wire order
+
+static void setColor(uint8_t* p, uint32_t rgb){
+  p[0] = rgb >> 8;
+  p[1] = rgb >> 16;
+  p[2] = rgb;
+}
+
+// a + (b - a) * w / 256 per channel
+static void mixColor(uint8_t* p, uint32_t a, uint32_t b, uint16_t w){
+  uint16_t k = 256 - w;
+  p[0] = (((a >> 8) & 0xFF) * k + ((b >> 8) & 0xFF) * w) >> 8;
+  p[1] = (((a >> 16) & 0xFF) * k + ((b >> 16) & 0xFF) * w) >> 8;
+  p[2] = ((a & 0xFF) * k + (b & 0xFF) * w) >> 8;
+}
+
+// fully saturated hue, 0..255 once around the colour wheel
+static void wheel(uint8_t* p, uint8_t hue){
+  uint8_t h = hue % 85 * 3;
+  if(hue < 85)       { p[0] = h;       p[1] = 255 - h; p[2] = 0; }
+  else if(hue < 170) { p[0] = 255 - h; p[1] = 0;       p[2] = h; }
+  else               { p[0] = 0;       p[1] = h;       p[2] = 255 - h; }
+}
+
+// quarter sine wave, 0..255 maps to one period of 0..254
+static const uint8_t sine_quarter[65] PROGMEM = {
+  127,130,133,136,139,143,146,149,152,155,158,161,164,167,170,173,
+  176,179,182,184,187,190,193,195,198,200,203,205,208,210,213,215,
+  217,219,221,224,226,228,229,231,233,235,236,238,239,241,242,244,
+  245,246,247,248,249,250,251,251,252,253,253,254,254,254,254,254,
+  254
+};
+
+static uint8_t sin8(uint8_t x){
+  uint8_t q = x & 0x3F;
+  switch(x >> 6){
+    case 0: return pgm_read_byte(&sine_quarter[q]);
+    case 1: return pgm_read_byte(&sine_quarter[64 - q]);
+    case 2: return 254 - pgm_read_byte(&sine_quarter[q]);
+    default: return 254 - pgm_read_byte(&sine_quarter[64 - q]);
+  }
+}
+
+void Pattern::begin(uint16_t leds, uint32_t rows, uint32_t line_us, const PatternParams& params){
+  _leds = leds;
+  _rows = rows;
+  _line_us = line_us;
+  _params = params;
+  if(_params.size == 0)
+    _params.size = 1;
+}
+
+bool Pattern::readRow(uint32_t row, uint8_t* dst){
+  if(row >= _rows)
+    return false;
+  render(row, (uint64_t)row * _line_us / 1000, dst);
+  return true;
+}
+
+// Colour wheel along the strip, size LEDs per turn, turning speed hue steps per second
+class RainbowPattern : public Pattern {
+  protected:
+    void render(uint32_t, uint32_t t_ms, uint8_t* dst){
+      uint16_t step = (uint32_t)(256 << 8) / _params.size;
+      uint16_t hue = (int32_t)t_ms * _params.speed / 1000 << 8;
+      for(uint16_t i = 0; i < _leds; i++, dst += 3, hue += step)
+        wheel(dst, hue >> 8);
+    }
+};
+
+// color1 to color2 and back along the strip, moving by speed LEDs per second
+class GradientPattern : public Pattern {
+  protected:
+    void render(uint32_t, uint32_t t_ms, uint8_t* dst){
+      //position in 1/256 LED, one sweep is 2 * _leds
+      uint32_t period = (uint32_t)_leds << 9;
+      uint32_t pos = ((int64_t)t_ms * _params.speed * 256 / 1000) % (int32_t)period + period;
+      for(uint16_t i = 0; i < _leds; i++, dst += 3, pos += 256){
+        uint32_t p = pos % period;
+        if(p >= period / 2)
+          p = period - p;
+        mixColor(dst, _params.color1, _params.color2, p / _leds);
+      }
+    }
+};
+
+// dots of color1 every size LEDs on color2, with a short tail, speed LEDs per second
+class ChasePattern : public Pattern {
+  protected:
+    void render(uint32_t, uint32_t t_ms, uint8_t* dst){
+      uint16_t size = _params.size < 2 ? 2 : _params.size;
+      int32_t shift = (int64_t)t_ms * _params.speed / 1000 % size;
+      //d is how far LED i is behind the next dot
+      uint16_t d = (size + shift) % size;
+      for(uint16_t i = 0; i < _leds; i++, dst += 3){
+        //the tail halves its brightness from LED to LED
+        mixColor(dst, _params.color2, _params.color1, d < 8 ? 256 >> d : 0);
+        d = d == 0 ? size - 1 : d - 1;
+      }
+    }
+};
+
+// two moving sine waves mixed into a hue, size scales the waves
+class PlasmaPattern : public Pattern {
+  protected:
+    void render(uint32_t row, uint32_t t_ms, uint8_t* dst){
+      uint8_t t = (int32_t)t_ms * _params.speed / 1000;
+      uint16_t step = (256 << 4) / _params.size;
+      uint16_t x = 0;
+      for(uint16_t i = 0; i < _leds; i++, dst += 3, x += step){
+        uint8_t a = sin8((x >> 4) + t);
+        uint8_t b = sin8((x >> 3) - t * 2 + (row & 0xFF));
+        wheel(dst, (a + b) >> 1);
+      }
+    }
+};
+
+#define FONT_FIRST ' '
+#define FONT_LAST '~'
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+#define FONT_SPACING 1
+
+// 5x7 font, one byte per column, bit 0 is the top
+static const uint8_t font5x7[(FONT_LAST - FONT_FIRST + 1) * FONT_WIDTH] PROGMEM = {
+  0x00,0x00,0x00,0x00,0x00, 0x00,0x00,0x5F,0x00,0x00, 0x00,0x07,0x00,0x07,0x00, 0x14,0x7F,0x14,0x7F,0x14,   //  !"#
+  0x24,0x2A,0x7F,0x2A,0x12, 0x23,0x13,0x08,0x64,0x62, 0x36,0x49,0x55,0x22,0x50, 0x00,0x05,0x03,0x00,0x00,   // $%&'
+  0x00,0x1C,0x22,0x41,0x00, 0x00,0x41,0x22,0x1C,0x00, 0x08,0x2A,0x1C,0x2A,0x08, 0x08,0x08,0x3E,0x08,0x08,   // ()*+
+  0x00,0x50,0x30,0x00,0x00, 0x08,0x08,0x08,0x08,0x08, 0x00,0x60,0x60,0x00,0x00, 0x20,0x10,0x08,0x04,0x02,   // ,-./
+  0x3E,0x51,0x49,0x45,0x3E, 0x00,0x42,0x7F,0x40,0x00, 0x42,0x61,0x51,0x49,0x46, 0x21,0x41,0x45,0x4B,0x31,   // 0123
+  0x18,0x14,0x12,0x7F,0x10, 0x27,0x45,0x45,0x45,0x39, 0x3C,0x4A,0x49,0x49,0x30, 0x01,0x71,0x09,0x05,0x03,   // 4567
+  0x36,0x49,0x49,0x49,0x36, 0x06,0x49,0x49,0x29,0x1E, 0x00,0x36,0x36,0x00,0x00, 0x00,0x56,0x36,0x00,0x00,   // 89:;
+  0x08,0x14,0x22,0x41,0x00, 0x14,0x14,0x14,0x14,0x14, 0x00,0x41,0x22,0x14,0x08, 0x02,0x01,0x51,0x09,0x06,   // <=>?
+  0x32,0x49,0x79,0x41,0x3E, 0x7E,0x11,0x11,0x11,0x7E, 0x7F,0x49,0x49,0x49,0x36, 0x3E,0x41,0x41,0x41,0x22,   // @ABC
+  0x7F,0x41,0x41,0x22,0x1C, 0x7F,0x49,0x49,0x49,0x41, 0x7F,0x09,0x09,0x09,0x01, 0x3E,0x41,0x49,0x49,0x7A,   // DEFG
+  0x7F,0x08,0x08,0x08,0x7F, 0x00,0x41,0x7F,0x41,0x00, 0x20,0x40,0x41,0x3F,0x01, 0x7F,0x08,0x14,0x22,0x41,   // HIJK
+  0x7F,0x40,0x40,0x40,0x40, 0x7F,0x02,0x0C,0x02,0x7F, 0x7F,0x04,0x08,0x10,0x7F, 0x3E,0x41,0x41,0x41,0x3E,   // LMNO
+  0x7F,0x09,0x09,0x09,0x06, 0x3E,0x41,0x51,0x21,0x5E, 0x7F,0x09,0x19,0x29,0x46, 0x46,0x49,0x49,0x49,0x31,   // PQRS
+  0x01,0x01,0x7F,0x01,0x01, 0x3F,0x40,0x40,0x40,0x3F, 0x1F,0x20,0x40,0x20,0x1F, 0x3F,0x40,0x38,0x40,0x3F,   // TUVW
+  0x63,0x14,0x08,0x14,0x63, 0x07,0x08,0x70,0x08,0x07, 0x61,0x51,0x49,0x45,0x43, 0x00,0x7F,0x41,0x41,0x00,   // XYZ[
+  0x02,0x04,0x08,0x10,0x20, 0x00,0x41,0x41,0x7F,0x00, 0x04,0x02,0x01,0x02,0x04, 0x40,0x40,0x40,0x40,0x40,   // \]^_
+  0x00,0x01,0x02,0x04,0x00, 0x20,0x54,0x54,0x54,0x78, 0x7F,0x48,0x44,0x44,0x38, 0x38,0x44,0x44,0x44,0x20,   // `abc
+  0x38,0x44,0x44,0x48,0x7F, 0x38,0x54,0x54,0x54,0x18, 0x08,0x7E,0x09,0x01,0x02, 0x0C,0x52,0x52,0x52,0x3E,   // defg
+  0x7F,0x08,0x04,0x04,0x78, 0x00,0x44,0x7D,0x40,0x00, 0x20,0x40,0x44,0x3D,0x00, 0x7F,0x10,0x28,0x44,0x00,   // hijk
+  0x00,0x41,0x7F,0x40,0x00, 0x7C,0x04,0x18,0x04,0x78, 0x7C,0x08,0x04,0x04,0x78, 0x38,0x44,0x44,0x44,0x38,   // lmno
+  0x7C,0x14,0x14,0x14,0x08, 0x08,0x14,0x14,0x18,0x7C, 0x7C,0x08,0x04,0x04,0x08, 0x48,0x54,0x54,0x54,0x20,   // pqrs
+  0x04,0x3F,0x44,0x40,0x20, 0x3C,0x40,0x40,0x20,0x7C, 0x1C,0x20,0x40,0x20,0x1C, 0x3C,0x40,0x30,0x40,0x3C,   // tuvw
+  0x44,0x28,0x10,0x28,0x44, 0x0C,0x50,0x50,0x50,0x3C, 0x44,0x64,0x54,0x4C,0x44, 0x00,0x08,0x36,0x41,0x00,   // xyz{
+  0x00,0x00,0x7F,0x00,0x00, 0x00,0x41,0x36,0x08,0x00, 0x08,0x04,0x08,0x10,0x08                              // |}~
+};
+
+// text in color1 on color2, the letters are as high as the strip (LED 0 is
+// at their bottom) and each font column is drawn for size rows
+class TextPattern : public Pattern {
+  public:
+    void begin(uint16_t leds, uint32_t rows, uint32_t line_us, const PatternParams& params){
+      Pattern::begin(leds, rows, line_us, params);
+      _params.text[PATTERN_TEXT_LEN - 1] = 0;
+      _rows = (uint32_t)strlen(_params.text) * (FONT_WIDTH + FONT_SPACING) * _params.size;
+    }
+  protected:
+    void render(uint32_t row, uint32_t, uint8_t* dst){
+      uint32_t col = row / _params.size;
+      uint8_t c = _params.text[col / (FONT_WIDTH + FONT_SPACING)];
+      uint8_t x = col % (FONT_WIDTH + FONT_SPACING);
+      uint8_t bits = 0;
+      if(x < FONT_WIDTH && c >= FONT_FIRST && c <= FONT_LAST)
+        bits = pgm_read_byte(&font5x7[(c - FONT_FIRST) * FONT_WIDTH + x]);
+      for(uint16_t i = 0; i < _leds; i++, dst += 3){
+        uint8_t y = FONT_HEIGHT - 1 - (uint32_t)i * FONT_HEIGHT / _leds;
+        setColor(dst, bits & (1 << y) ? _params.color1 : _params.color2);
+      }
+    }
+};
+
+template<typename T> static Pattern* make() { return new T(); }
+
+struct PatternEntry {
+  const char* name;
+  Pattern* (*create)();
+};
+
+static const PatternEntry pattern_registry[] = {
+  { "rainbow", make<RainbowPattern> },
+  { "gradient", make<GradientPattern> },
+  { "chase", make<ChasePattern> },
+  { "plasma", make<PlasmaPattern> },
+  { "text", make<TextPattern> },
+};
+
+uint8_t patternCount(){
+  return sizeof(pattern_registry) / sizeof(pattern_registry[0]);
+}
+
+const char* patternName(uint8_t index){
+  return index < patternCount() ? pattern_registry[index].name : NULL;
+}
+
+Pattern* createPattern(const char* name){
+  for(uint8_t i = 0; i < patternCount(); i++)
+    if(!strcmp(name, pattern_registry[i].name))
+      return pattern_registry[i].create();
+  return NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdint.h>
+#include "ImageFormat.h"
+
+#define PATTERN_NAME_LEN 12
+#define PATTERN_TEXT_LEN 32
+
+// Settings of a pattern, what they mean depends on the pattern
+struct PatternParams {
+  uint32_t color1;            // 0xRRGGBB
+  uint32_t color2;
+  int16_t speed;              // movement per second (hue steps or LEDs)
+  uint16_t size;              // LEDs per colour cycle, chase spacing, rows per text column
+  char text[PATTERN_TEXT_LEN];
+};
+
+// A generated image: every row is computed from its index, the time it is
+// shown at and the parameters, with integer math only. Patterns are drawn
+// through the same RowPipeline as files, so they get the same line timing,
+// colour table and stretching.
+class Pattern : public RowSource {
+  public:
+    Pattern() : _leds(0), _rows(0), _line_us(0) {}
+
+    // rows is ignored by patterns with a natural length (text)
+    virtual void begin(uint16_t leds, uint32_t rows, uint32_t line_us, const PatternParams& params);
+    uint16_t width() const { return _leds; }
+    uint32_t rows() const { return _rows; }
+    bool readRow(uint32_t row, uint8_t* dst);
+
+  protected:
+    // fills dst with _leds GRB pixels for row, t_ms after the first row
+    virtual void render(uint32_t row, uint32_t t_ms, uint8_t* dst) = 0;
+
+    uint16_t _leds;
+    uint32_t _rows;
+    uint32_t _line_us;
+    PatternParams _params;
+};
+
+// Registry of the patterns by name, for the configuration
+uint8_t patternCount();
+const char* patternName(uint8_t index);
+Pattern* createPattern(const char* name);     // NULL if there is no such pattern
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "Playlist.h"
+#include "WsEncoder.h"
+
+PlaylistSource::PlaylistSource()
+  : _count(0), _open(-1), _last(0), _src(NULL), _opener(NULL), _mode(RESAMPLE_OFF), _scratch(NULL), _leds(0), _rows(0) {
+}
+
+PlaylistSource::~PlaylistSource(){
+  end();
+}
+
+bool PlaylistSource::begin(const PlaylistEntry* entries, uint8_t count, uint32_t line_us, uint16_t leds, ResampleMode mode,
+                           Opener& opener){
+  uint16_t max_width = 0;
+  bool scale = false;
+
+  end();
+  _opener = &opener;
+  _leds = leds;
+  _mode = mode;
+  _count = count < PLAYLIST_MAX ? count : PLAYLIST_MAX;
+  memcpy(_entries, entries, _count * sizeof(PlaylistEntry));
+
+  //the headers are read once here, so the number of rows is known and
+  //nothing can fail between two entries later
+  for(uint8_t i = 0; i < _count; i++){
+    Part& part = _parts[i];
+    PlaylistEntry& entry = _entries[i];
+    entry.name[PLAYLIST_NAME_LEN - 1] = 0;
+    part.line_us = entry.line_time ? entry.line_time * 1000UL : line_us;
+    //a line time of 0 (unchecked from /config) draws as fast as the strip takes
+    //the rows, which is also the length of a gap row
+    if(part.line_us == 0)
+      part.line_us = (uint32_t)leds * 3 * WS_BYTE_US + WS_LATCH_US;
+    RowSource* src = opener.openEntry(entry, part.line_us);
+    if(!src || src->rows() == 0 || (src->width() > leds && mode == RESAMPLE_OFF)){
+      opener.closeEntry();
+      _count = i;
+      end();
+      return false;
+    }
+    if(src->width() > max_width)
+      max_width = src->width();
+    scale |= src->width() != leds;
+    part.first = _rows;
+    part.image_rows = src->rows();
+    part.drawn_rows = part.image_rows * (entry.repeat ? entry.repeat : 1);
+    part.rows = part.drawn_rows + ((uint32_t)entry.gap * 1000 + part.line_us - 1) / part.line_us;
+    _rows += part.rows;
+  }
+  opener.closeEntry();
+
+  //scaled entries are read into the scratch row first
+  if(scale && mode != RESAMPLE_OFF && (_scratch = (uint8_t *)malloc(max_width * 3)) == NULL){
+    end();
+    return false;
+  }
+  return _count > 0;
+}
+
+void PlaylistSource::end(){
+  if(_opener && _open >= 0)
+    _opener->closeEntry();
+  _open = -1;
+  _last = 0;
+  _src = NULL;
+  _rows = 0;
+  _resampler.end();
+  free(_scratch);
+  _scratch = NULL;
+}
+
+bool PlaylistSource::contains(const char* name) const{
+  for(uint8_t i = 0; i < _count; i++)
+    if(!strcmp(_entries[i].name, name))
+      return true;
+  return false;
+}
+
+int PlaylistSource::partOf(uint32_t row) const{
+  if(row >= _rows)
+    return -1;
+  //rows are read in order, start with the entry of the last one
+  int i = row >= _parts[_last].first ? _last : 0;
+  while(row >= _parts[i].first + _parts[i].rows)
+    i++;
+  return i;
+}
+
+bool PlaylistSource::openPart(uint8_t index){
+  _resampler.end();
+  _src = _opener->openEntry(_entries[index], _parts[index].line_us);
+  _open = _src ? index : -1;
+  if(!_src || _src->rows() != _parts[index].image_rows)
+    return false;
+  if(_src->width() != _leds && _scratch)
+    return _resampler.begin(_src->width(), _leds, _mode);
+  return true;
+}
+
+bool PlaylistSource::readRow(uint32_t row, uint8_t* dst){
+  int index = partOf(row);
+  if(index < 0)
+    return false;
+  _last = index;
+
+  const Part& part = _parts[index];
+  uint32_t local = row - part.first;
+  memset(dst, 0, _leds * 3);
+  if(local >= part.drawn_rows)
+    return true;              // gap
+  if(_open != index && !openPart(index))
+    return false;
+
+  local %= part.image_rows;
+  if(_entries[index].reverse)
+    local = part.image_rows - 1 - local;
+  if(_resampler.active()){
+    bool ok = _src->readRow(local, _scratch);
+    _resampler.apply(dst, _scratch);
+    return ok;
+  }
+  //narrower entries light the first LEDs
+  return _src->readRow(local, dst);
+}
+
+uint32_t PlaylistSource::linePeriod(uint32_t row) const{
+  int index = partOf(row);
+  return index < 0 ? 0 : _parts[index].line_us;
+}
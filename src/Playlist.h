@@ -0,0 +1,77 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdint.h>
+#include "ImageFormat.h"
+#include "Resampler.h"
+
+#define PLAYLIST_MAX 8
+#define PLAYLIST_NAME_LEN 32
+
+struct PlaylistEntry {
+  char name[PLAYLIST_NAME_LEN];   // image file (starting with /) or pattern name
+  uint16_t line_time;             // ms per row, 0 for the configured line time
+  uint8_t repeat;                 // times the entry is drawn in a row, at least once
+  bool reverse;                   // last row first
+  uint16_t gap;                   // ms dark after the entry
+};
+
+// The entries of a playlist one after the other as a single source, so the
+// RowPipeline reads ahead across the end of an entry like inside one: the
+// next file is opened and its first rows are in the ring while the current
+// one is still drawn, and the first row of an entry lands on the next line
+// edge. Rows are always as wide as the strip, entries of another width are
+// scaled (or padded with black). Opening the entries is left to an Opener,
+// only one entry is open at a time.
+class PlaylistSource : public RowSource {
+  public:
+    class Opener {
+      public:
+        virtual ~Opener() {}
+        // opens entry (closing the one before), NULL if it can't be drawn
+        virtual RowSource* openEntry(const PlaylistEntry& entry, uint32_t line_us) = 0;
+        virtual void closeEntry() = 0;
+    };
+
+    PlaylistSource();
+    ~PlaylistSource();
+
+    // opens every entry once for its size. False if one can't be opened or
+    // doesn't fit the strip
+    bool begin(const PlaylistEntry* entries, uint8_t count, uint32_t line_us, uint16_t leds, ResampleMode mode,
+               Opener& opener);
+    void end();
+    bool contains(const char* name) const;
+
+    uint16_t width() const { return _leds; }
+    uint32_t rows() const { return _rows; }
+    bool readRow(uint32_t row, uint8_t* dst);
+    uint32_t linePeriod(uint32_t row) const;
+
+  private:
+    struct Part {
+      uint32_t first;         // first row in the playlist
+      uint32_t image_rows;
+      uint32_t drawn_rows;    // image_rows * repeat, the gap follows
+      uint32_t rows;          // with the gap
+      uint32_t line_us;
+    };
+
+    int partOf(uint32_t row) const;
+    bool openPart(uint8_t index);
+
+    PlaylistEntry _entries[PLAYLIST_MAX];   // copied, the configuration may change meanwhile
+    Part _parts[PLAYLIST_MAX];
+    uint8_t _count;
+    int _open;                // entry _src belongs to, -1 for none
+    int _last;                // entry of the last readRow(), where partOf() starts to look
+    RowSource* _src;
+    Opener* _opener;
+    Resampler _resampler;
+    ResampleMode _mode;
+    uint8_t* _scratch;        // unscaled row
+    uint16_t _leds;
+    uint32_t _rows;
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <stdlib.h>
+#include <math.h>
+#include "Resampler.h"
+
+#define WEIGHT_ONE 256
+
+Resampler::Resampler()
+  : _src_width(0), _dst_width(0), _mode(RESAMPLE_OFF), _first(NULL), _count(NULL), _weights(NULL) {
+}
+
+Resampler::~Resampler(){
+  end();
+}
+
+template<typename F> void Resampler::taps(F& tap) const{
+  float scale = (float)_src_width / _dst_width;
+
+  for(uint16_t i = 0; i < _dst_width; i++){
+    if(_mode == RESAMPLE_NEAREST){
+      int j = (int)((i + 0.5f) * scale);
+      tap(i, j < _src_width ? j : _src_width - 1, 1.0f);
+    }
+    else if(_mode == RESAMPLE_BILINEAR){
+      //pixel centres line up, the ends are clamped
+      float x = (i + 0.5f) * scale - 0.5f;
+      if(x < 0) x = 0;
+      if(x > _src_width - 1) x = _src_width - 1;
+      int j = (int)x;
+      float f = x - j;
+      tap(i, j, 1.0f - f);
+      if(j + 1 < _src_width)
+        tap(i, j + 1, f);
+    }
+    else{
+      //every source pixel weighted by how much of it the LED covers
+      float lo = i * scale, hi = (i + 1) * scale;
+      for(int j = (int)lo; j < _src_width && j < hi; j++){
+        float a = j > lo ? j : lo;
+        float b = j + 1 < hi ? j + 1 : hi;
+        tap(i, j, (b - a) / scale);
+      }
+    }
+  }
+}
+
+// First pass of begin(), counts the taps
+struct TapCounter {
+  TapCounter() : total(0) {}
+  void operator()(uint16_t, int, float) { total++; }
+  size_t total;
+};
+
+// Second pass, quantizes the weights. The running sum is rounded instead of
+// each weight, so rounding errors don't add up over the taps
+struct TapWriter {
+  TapWriter(uint16_t* first, uint8_t* count, uint16_t* weights)
+    : first(first), count(count), weights(weights), pixel(-1), sum(0), done(0) {}
+  void operator()(uint16_t i, int j, float w){
+    if(i != pixel){
+      pixel = i;
+      first[i] = j;
+      count[i] = 0;
+      sum = 0;
+      done = 0;
+    }
+    sum += w;
+    int q = (int)(sum * WEIGHT_ONE + 0.5f);
+    if(q > WEIGHT_ONE) q = WEIGHT_ONE;
+    *weights++ = q - done;
+    done = q;
+    count[i]++;
+  }
+  uint16_t* first;
+  uint8_t* count;
+  uint16_t* weights;
+  int pixel;
+  float sum;
+  int done;
+};
+
+bool Resampler::begin(uint16_t src_width, uint16_t dst_width, ResampleMode mode){
+  end();
+  if(mode == RESAMPLE_OFF || src_width == 0 || dst_width == 0)
+    return false;
+  //more than 255 taps per LED only with images way too wide for the flash anyway
+  if(mode == RESAMPLE_BOX && src_width / dst_width > 250)
+    mode = RESAMPLE_BILINEAR;
+  _src_width = src_width;
+  _dst_width = dst_width;
+  _mode = mode;
+
+  TapCounter counter;
+  taps(counter);
+  _first = (uint16_t *)malloc(dst_width * sizeof(uint16_t));
+  _count = (uint8_t *)malloc(dst_width);
+  _weights = (uint16_t *)malloc(counter.total * sizeof(uint16_t));
+  if(!_first || !_count || !_weights){
+    end();
+    return false;
+  }
+  TapWriter writer(_first, _count, _weights);
+  taps(writer);
+  //float sums can end a bit short of 1, the last weight of a set takes the rest
+  uint16_t* w = _weights;
+  for(uint16_t i = 0; i < dst_width; i++){
+    uint16_t sum = 0;
+    for(uint8_t t = 0; t < _count[i]; t++)
+      sum += *w++;
+    w[-1] += WEIGHT_ONE - sum;
+  }
+  return true;
+}
+
+void Resampler::end(){
+  free(_first);
+  free(_count);
+  free(_weights);
+  _first = _weights = NULL;
+  _count = NULL;
+}
+
+void Resampler::apply(uint8_t* dst, const uint8_t* src) const{
+  const uint16_t* w = _weights;
+
+  if(_mode == RESAMPLE_NEAREST){
+    for(uint16_t i = 0; i < _dst_width; i++, dst += 3){
+      const uint8_t* s = src + _first[i] * 3;
+      dst[0] = s[0];
+      dst[1] = s[1];
+      dst[2] = s[2];
+    }
+    return;
+  }
+  for(uint16_t i = 0; i < _dst_width; i++, dst += 3){
+    const uint8_t* s = src + _first[i] * 3;
+    uint32_t g = WEIGHT_ONE / 2, r = WEIGHT_ONE / 2, b = WEIGHT_ONE / 2;
+    for(uint8_t t = _count[i]; t > 0; t--, s += 3, w++){
+      g += s[0] * *w;
+      r += s[1] * *w;
+      b += s[2] * *w;
+    }
+    dst[0] = g >> 8;
+    dst[1] = r >> 8;
+    dst[2] = b >> 8;
+  }
+}
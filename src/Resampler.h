@@ -0,0 +1,43 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum ResampleMode { RESAMPLE_OFF, RESAMPLE_NEAREST, RESAMPLE_BILINEAR, RESAMPLE_BOX };
+
+// Scales a row of GRB pixels to another number of pixels (the image width to
+// the strip length). The source pixels and 8.8 fixed point weights for each
+// strip pixel are worked out once in begin(), a row then costs one
+// multiply-add per tap and channel: 1 tap for nearest, 2 for bilinear and
+// about source/strip width for the box filter, which averages all source
+// pixels a LED covers when scaling down.
+class Resampler {
+  public:
+    Resampler();
+    ~Resampler();
+
+    // false if mode is RESAMPLE_OFF or the tables don't fit into the heap
+    bool begin(uint16_t src_width, uint16_t dst_width, ResampleMode mode);
+    void end();
+
+    bool active() const { return _first != NULL; }
+    uint16_t srcWidth() const { return _src_width; }
+    uint16_t dstWidth() const { return _dst_width; }
+
+    // dst gets dstWidth() pixels from the srcWidth() pixels in src, both GRB
+    void apply(uint8_t* dst, const uint8_t* src) const;
+
+  private:
+    // calls tap(i, j, w) for every source pixel j of strip pixel i, weights as float
+    template<typename F> void taps(F& tap) const;
+
+    uint16_t _src_width;
+    uint16_t _dst_width;
+    ResampleMode _mode;
+    uint16_t* _first;     // first source pixel per strip pixel
+    uint8_t* _count;      // number of taps per strip pixel
+    uint16_t* _weights;   // all taps one after the other, each set adds up to 256
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "RowPipeline.h"
+#include "Metrics.h"
+
+RowPipeline::RowPipeline(LineScheduler& scheduler, const ColorLut& lut)
+  : _scheduler(scheduler), _lut(lut), _resample(RESAMPLE_BOX), _scratch(NULL), _width(0), _img(NULL), _output(NULL), _direct(false),
+    _direct_loaded(false), _failed(false), _stretch(1), _interpolate(false), _linear(false), _blend(false), _line(0),
+    _repeat(0), _row(0), _shown(0), _lines(0), _fill_time(0) {
+}
+
+void RowPipeline::setStretch(uint8_t stretch, bool interpolate){
+  _stretch = stretch < 1 ? 1 : (stretch > STRETCH_MAX ? STRETCH_MAX : stretch);
+  _interpolate = interpolate;
+}
+
+bool RowPipeline::begin(RowSource* img, uint8_t ring_slots, uint16_t leds){
+  end();
+  _img = img;
+  _width = img->width();
+  //the tables are built once here, a row then only costs the multiply-adds
+  if(_width != leds && _resampler.begin(_width, leds, _resample)){
+    _scratch = (uint8_t *)malloc(_width * 3);
+    if(!_scratch)
+      _resampler.end();
+    else
+      _width = leds;
+  }
+  //narrower images are drawn on the first LEDs if they can't be scaled
+  if(_width > leds)
+    return false;
+  _row = _shown = _lines = _fill_time = 0;
+  _line = _repeat = 0;
+  _direct_loaded = false;
+  _failed = false;
+  //blending needs the row and the next one at the same time
+  if(_stretch > 1 && _interpolate && ring_slots < 2)
+    ring_slots = 2;
+  //never more rows than the image has, fall back to direct if the heap is short
+  if(ring_slots > _img->rows())
+    ring_slots = _img->rows();
+  _direct = ring_slots == 0 || _ring.begin(ring_slots, _width * 3) == 0;
+  //without blending a stretched row is just shown again, direct mode reads it again
+  _linear = !_direct && _stretch > 1;
+  _blend = _linear && _interpolate && _ring.slots() >= 2;
+  return true;
+}
+
+bool RowPipeline::preload(){
+  if(_direct || _failed || _ring.full() || _row >= _img->rows())
+    return false;
+  return loadRow();
+}
+
+void RowPipeline::start(StripOutput* output, uint32_t line_us){
+  _output = output;
+  if(_direct)
+    loadRow();
+  _scheduler.start(line_us);
+}
+
+bool RowPipeline::service(){
+  if(_failed)
+    return false;
+  if(_scheduler.untilNextLine() > LINE_SERVICE_US){
+    //enough time for other work, read ahead if the time allows
+    if(!_direct && !_ring.full() && _row < _img->rows() && _scheduler.untilNextLine() > (int32_t)(_fill_time + LINE_SERVICE_US))
+      loadRow();
+    return true;
+  }
+
+  uint32_t wait_start = metrics.start();
+  _scheduler.waitForLine();
+  metrics.record(METRIC_WAIT, wait_start);
+  if(!rowReady()){
+    //the last row was on for its full line time
+    return false;
+  }
+  showRow();
+  //the rows for the next edge have to be ready in any case
+  while(needRow() && loadRow())
+    ;
+  return true;
+}
+
+void RowPipeline::end(){
+  _ring.end();
+  _resampler.end();
+  free(_scratch);
+  _scratch = NULL;
+  _output = NULL;
+}
+
+bool RowPipeline::rowReady() const{
+  return _direct ? _direct_loaded : !_ring.empty();
+}
+
+bool RowPipeline::needRow() const{
+  if(_row >= _img->rows())
+    return false;
+  if(_direct)
+    return !_direct_loaded;
+  return _ring.count() < (_blend ? 2 : 1);
+}
+
+bool RowPipeline::loadRow(){
+  uint32_t fill_start = _scheduler.now();
+  uint32_t start;
+  uint8_t * dst;
+  bool ok;
+
+  if(_failed || _row >= _img->rows())
+    return false;
+  dst = _direct ? _output->pixels() : _ring.writeSlot();
+  start = metrics.start();
+  if(_scratch){
+    ok = _img->readRow(_row, _scratch);
+    _resampler.apply(dst, _scratch);
+  }
+  else{
+    ok = _img->readRow(_row, dst);
+  }
+  metrics.record(METRIC_ROW_READ, start);
+  //gamma, brightness and white balance in one lookup per byte, stretched
+  //rows get them when each line is put together
+  if(!_linear){
+    start = metrics.start();
+    _lut.apply(dst, _width, _row + _repeat);
+    metrics.record(METRIC_CONVERT, start);
+  }
+  if(!_direct || ++_repeat >= _stretch){
+    _row++;
+    _repeat = 0;
+  }
+  //a half read row is never shown, the draw ends at the next line edge
+  if(!ok)
+    _failed = true;
+  else if(_direct)
+    _direct_loaded = true;
+  else
+    _ring.commit();
+  _fill_time = _scheduler.now() - fill_start;
+  return ok;
+}
+
+void RowPipeline::showRow(){
+  uint32_t start;
+
+  //rows are pushed only on the line edge, already in wire order
+  if(_line == 0){
+    //playlist entries can have their own line time, it starts with their first row
+    uint32_t period = _img->linePeriod(_shown);
+    if(period && period != _scheduler.period())
+      _scheduler.setPeriod(period);
+    _shown++;
+  }
+  if(_direct){
+    _direct_loaded = false;
+  }
+  else if(_linear){
+    //the last row has no next one to blend into and is held
+    const uint8_t* cur = _ring.readSlot();
+    const uint8_t* next = _blend && _ring.count() > 1 ? _ring.peekSlot(1) : cur;
+    start = metrics.start();
+    _lut.blend(_output->pixels(), cur, next, _width, (_line << 8) / _stretch, _lines);
+    metrics.record(METRIC_CONVERT, start);
+    if(_line == _stretch - 1)
+      _ring.release();
+  }
+  else{
+    memcpy(_output->pixels(), _ring.readSlot(), _ring.rowBytes());
+    _ring.release();
+  }
+  start = metrics.start();
+  _output->show();
+  metrics.record(METRIC_SHOW, start);
+  _lines++;
+  if(++_line >= _stretch)
+    _line = 0;
+}
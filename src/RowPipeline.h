@@ -0,0 +1,85 @@
+#ifndef ROW_PIPELINE_H
+#define ROW_PIPELINE_H
+
+#include <stdint.h>
+#include "ImageFormat.h"
+#include "RowRing.h"
+#include "ColorLut.h"
+#include "LineScheduler.h"
+#include "StripOutput.h"
+#include "Resampler.h"
+
+// When the next line edge is closer than this, service() waits for it instead
+// of returning, so serving a web request doesn't make the row late
+#define LINE_SERVICE_US 5000
+
+#define STRETCH_MAX 16          // most lines a row can be stretched to
+
+// The row path of a drawing: reads rows of an image or pattern (ahead into a
+// RowRing if there is one), applies the ColorLut and pushes them to the
+// StripOutput on the line edges of the LineScheduler. Nothing in here is
+// tied to the ESP8266, so it also runs on the PC (see tools/drawsim.cpp).
+//
+// With a stretch of K every row is on for K lines, so a short image gives a
+// K times longer stroke. With interpolation the K lines blend from the row
+// into the next one instead of repeating it, which needs the ring to hold
+// both rows in linear values (the tables are applied per line then).
+//
+// Images which are not as wide as the strip is long are scaled to it while
+// the rows are read, unless the resample mode is RESAMPLE_OFF.
+class RowPipeline {
+  public:
+    RowPipeline(LineScheduler& scheduler, const ColorLut& lut);
+
+    // lines per row (1..STRETCH_MAX), takes effect with the next begin()
+    void setStretch(uint8_t stretch, bool interpolate);
+    // how to scale images to the strip, takes effect with the next begin()
+    void setResample(ResampleMode mode) { _resample = mode; }
+
+    // img must stay open until end(). Up to ring_slots rows are read ahead,
+    // 0 reads each row straight into the output once the previous is shown.
+    // False if the image is wider than the strip and can't be scaled
+    bool begin(RowSource* img, uint8_t ring_slots, uint16_t leds);
+    bool preload();             // reads one row ahead before start(), false when the ring is full
+    void start(StripOutput* output, uint32_t line_us);
+    bool service();             // does what is due, false after the last row was on for its line time or a read error
+    void end();
+
+    bool canService() const { return _scheduler.untilNextLine() > LINE_SERVICE_US; }
+    uint32_t shown() const { return _shown; }     // rows, not lines
+    uint32_t fillTime() const { return _fill_time; }
+    bool direct() const { return _direct; }
+    bool scaled() const { return _resampler.active(); }
+    bool failed() const { return _failed; }       // a row couldn't be read, the draw ended early
+
+  private:
+    bool loadRow();             // reads the next row into the ring or the output
+    bool rowReady() const;      // a row is there to be shown
+    bool needRow() const;       // the next line needs another row read first
+    void showRow();
+
+    LineScheduler& _scheduler;
+    const ColorLut& _lut;
+    RowRing _ring;
+    Resampler _resampler;
+    ResampleMode _resample;
+    uint8_t* _scratch;          // unscaled row when resampling
+    uint16_t _width;            // pixels per row on the strip
+    RowSource* _img;
+    StripOutput* _output;
+    bool _direct;               // no ring, rows are read straight into the output
+    bool _direct_loaded;        // the output holds the next row
+    bool _failed;               // a row read failed, nothing after it is shown
+    uint8_t _stretch;
+    bool _interpolate;
+    bool _linear;               // the ring holds rows without the tables applied
+    bool _blend;                // lines are blended between two rows
+    uint8_t _line;              // line of the current row, 0.._stretch-1
+    uint8_t _repeat;            // direct mode: times the current row was read
+    uint32_t _row;              // next row to read
+    uint32_t _shown;
+    uint32_t _lines;
+    uint32_t _fill_time;        // how long the last row took to read and convert
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+#include <stdlib.h>
+#include "RowRing.h"
+
+RowRing::RowRing()
+  : _buffer(NULL), _row_bytes(0), _stride(0), _slots(0), _count(0), _read(0), _write(0) {
+}
+
+RowRing::~RowRing(){
+  end();
+}
+
+uint8_t RowRing::begin(uint8_t slots, size_t row_bytes){
+  end();
+  if(row_bytes == 0)
+    return 0;
+  _stride = (row_bytes + 3) & ~3;
+  //step down until the heap can hold the ring
+  while(slots > 0 && (_buffer = (uint8_t *)malloc(slots * _stride)) == NULL)
+    slots--;
+  _slots = slots;
+  _row_bytes = row_bytes;
+  return _slots;
+}
+
+void RowRing::end(){
+  free(_buffer);
+  _buffer = NULL;
+  _slots = _count = _read = _write = 0;
+}
+
+void RowRing::commit(){
+  if(full())
+    return;
+  _count++;
+  if(++_write == _slots) _write = 0;
+}
+
+void RowRing::release(){
+  if(empty())
+    return;
+  _count--;
+  if(++_read == _slots) _read = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef ROW_RING_H
+#define ROW_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Number of rows read ahead while the current row is shown
+#define ROW_RING_SLOTS 4
+
+// Fixed size ring of prepared strip rows (already in wire order). The producer
+// fills writeSlot() and commit()s it, the consumer takes readSlot() at the line
+// edge and release()s it again. Slots are word aligned for convertBgrRow().
+class RowRing {
+  public:
+    RowRing();
+    ~RowRing();
+
+    // allocates up to `slots` rows of `row_bytes`, fewer if the heap is short.
+    // Returns the number of slots actually allocated (0 on failure)
+    uint8_t begin(uint8_t slots, size_t row_bytes);
+    void end();
+
+    bool full() const { return _count == _slots; }
+    bool empty() const { return _count == 0; }
+    uint8_t count() const { return _count; }
+    uint8_t slots() const { return _slots; }
+    size_t rowBytes() const { return _row_bytes; }
+
+    uint8_t* writeSlot() { return _buffer + _write * _stride; }
+    void commit();
+    const uint8_t* readSlot() const { return _buffer + _read * _stride; }
+    // the n-th committed row after readSlot(), n < count()
+    const uint8_t* peekSlot(uint8_t n) const { return _buffer + ((_read + n) % _slots) * _stride; }
+    void release();
+
+  private:
+    uint8_t* _buffer;
+    size_t _row_bytes;
+    size_t _stride;     // row_bytes rounded up so every slot is word aligned
+    uint8_t _slots;
+    uint8_t _count;
+    uint8_t _read;
+    uint8_t _write;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SPIFFS_STREAM_H
+#define SPIFFS_STREAM_H
+
+#include <FS.h>
+#include "ImageFormat.h"
+
+// ByteSource/ByteSink on top of a SPIFFS File
+class FileSource : public ByteSource {
+  public:
+    FileSource(File& file) : _file(file) {}
+    size_t read(uint8_t* buf, size_t len) { return _file.read(buf, len); }
+    bool seek(uint32_t pos) { return _file.seek(pos, SeekSet); }
+    uint32_t position() { return _file.position(); }
+  private:
+    File& _file;
+};
+
+class FileSink : public ByteSink {
+  public:
+    FileSink(File& file) : _file(file) {}
+    size_t write(const uint8_t* buf, size_t len) { return _file.write(buf, len); }
+  private:
+    File& _file;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef STRIP_OUTPUT_H
+#define STRIP_OUTPUT_H
+
+#include <stdint.h>
+#include <string.h>
+
+enum OutputType { OUTPUT_NEOPIXEL, OUTPUT_UART, OUTPUT_PARALLEL };
+
+// Where the rows go. pixels() is the buffer for the next row in the wire
+// order of the strip, show() sends it and may return before it is on the wire.
+// The ESP8266 outputs are in EspOutput.h.
+class StripOutput {
+  public:
+    virtual ~StripOutput() {}
+    virtual bool begin(uint16_t leds, uint8_t pin) = 0;
+    virtual void end() = 0;
+    virtual uint8_t* pixels() = 0;
+    virtual void show() = 0;
+    // shows an all dark row
+    void clear() { memset(pixels(), 0, _leds * 3); show(); }
+
+  protected:
+    uint16_t _leds;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+#include "StripSegments.h"
+#include <stdlib.h>
+#include <string.h>
+
+int8_t parseSegments(const char* text, StripSegment* segments, uint8_t max){
+  uint8_t count = 0;
+  const char* p = text;
+  char* end;
+
+  while(*p){
+    if(count >= max)
+      return -1;
+    StripSegment& s = segments[count++];
+    unsigned long v[3];
+    for(int i = 0; i < 3; i++){
+      v[i] = strtoul(p, &end, 10);
+      if(end == p || (i < 2 && *end != ':'))
+        return -1;
+      p = i < 2 ? end + 1 : end;
+    }
+    if(v[0] > SEGMENT_PIN_MAX || v[1] > 0xFFFF || v[2] == 0 || v[2] > 0xFFFF)
+      return -1;
+    s.pin = v[0];
+    s.offset = v[1];
+    s.leds = v[2];
+    s.reverse = *p == 'r';
+    if(s.reverse)
+      p++;
+    if(*p == ',')
+      p++;
+    else if(*p)
+      return -1;
+  }
+  return count;
+}
+
+bool checkSegments(const StripSegment* segments, uint8_t count, uint16_t leds){
+  uint16_t pins = 0;
+
+  if(count == 0 || count > SEGMENTS_MAX)
+    return false;
+  for(uint8_t i = 0; i < count; i++){
+    const StripSegment& s = segments[i];
+    if(s.pin > SEGMENT_PIN_MAX || (pins & (1 << s.pin)) || s.leds == 0 || (uint32_t)s.offset + s.leds > leds)
+      return false;
+    pins |= 1 << s.pin;
+  }
+  return true;
+}
+
+bool ParallelEncoder::begin(const StripSegment* segments, uint8_t count, uint16_t leds){
+  end();
+  if(!checkSegments(segments, count, leds))
+    return false;
+  memcpy(_segments, segments, count * sizeof(StripSegment));
+  _count = count;
+  for(uint8_t i = 0; i < count; i++){
+    if(segments[i].leds > _longest)
+      _longest = segments[i].leds;
+    _pins |= 1 << segments[i].pin;
+  }
+  _planes = (uint16_t*)malloc(bits() * sizeof(uint16_t));
+  if(!_planes){
+    end();
+    return false;
+  }
+  return true;
+}
+
+void ParallelEncoder::end(){
+  free(_planes);
+  _planes = NULL;
+  _count = 0;
+  _longest = 0;
+  _pins = 0;
+}
+
+void ParallelEncoder::encode(const uint8_t* pixels){
+  memset(_planes, 0, bits() * sizeof(uint16_t));
+  for(uint8_t i = 0; i < _count; i++){
+    const StripSegment& s = _segments[i];
+    uint16_t mask = 1 << s.pin;
+    uint16_t* plane = _planes;
+    const uint8_t* led = pixels + (uint32_t)s.offset * 3;
+    int step = 3;
+    if(s.reverse){
+      led += (s.leds - 1) * 3;
+      step = -3;
+    }
+    for(uint16_t n = 0; n < s.leds; n++, led += step){
+      for(uint8_t c = 0; c < 3; c++){
+        uint8_t v = led[c];
+        //MSB first, a set bit adds the pin to its plane
+        for(uint8_t b = 0; b < 8; b++, v <<= 1)
+          *plane++ |= mask & -(uint16_t)(v >> 7);
+      }
+    }
+  }
+}
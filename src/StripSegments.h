@@ -0,0 +1,52 @@
+#ifndef STRIP_SEGMENTS_H
+#define STRIP_SEGMENTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SEGMENTS_MAX 4
+#define SEGMENTS_TEXT_LEN 48        // "pin:offset:leds[r]," for SEGMENTS_MAX segments
+#define SEGMENT_PIN_MAX 15          // set and cleared together by GPOS/GPOC
+
+// A piece of the row on a strip of its own: LEDs offset..offset+leds-1 of
+// the row go to the strip on pin, starting at the far end if reverse
+struct StripSegment {
+  uint8_t pin;
+  bool reverse;
+  uint16_t offset;
+  uint16_t leds;
+};
+
+// Parses "14:0:144,12:144:144r" (pin:offset:leds, r for reversed) into
+// segments, returns their number or -1 if text is not valid
+int8_t parseSegments(const char* text, StripSegment* segments, uint8_t max);
+
+// Checks that the pins are different and every segment is inside the row
+bool checkSegments(const StripSegment* segments, uint8_t count, uint16_t leds);
+
+// Turns a row into one GPIO mask per WS2812 bit, so all segments are sent in
+// one pass: the pins are set at the start of every bit, the pins of the mask
+// are kept high for a 1, all others go low early for a 0. Segments shorter
+// than the longest one get 0 bits at the end, which fall off their strip.
+class ParallelEncoder {
+  public:
+    ParallelEncoder() : _count(0), _longest(0), _pins(0), _planes(NULL) {}
+    ~ParallelEncoder() { end(); }
+    bool begin(const StripSegment* segments, uint8_t count, uint16_t leds);
+    void end();
+    // pixels is the whole row in the wire order of the strips (GRB)
+    void encode(const uint8_t* pixels);
+    const uint16_t* planes() const { return _planes; }
+    uint32_t bits() const { return (uint32_t)_longest * 24; }
+    uint16_t longest() const { return _longest; }
+    uint16_t pins() const { return _pins; }
+
+  private:
+    StripSegment _segments[SEGMENTS_MAX];
+    uint8_t _count;
+    uint16_t _longest;
+    uint16_t _pins;         // mask of all segment pins
+    uint16_t* _planes;
+};
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Thumbnail.h"
+
+#define BMP_HEADER_SIZE 54
+#define BMP_RLE8 1
+#define RLE_ROW_MAX (THUMB_SIDE_MAX * 2 + 2)  // encoded row of single pixels and its end of line
+
+static void put16(uint8_t* p, uint16_t v){
+  p[0] = v; p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v){
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// the 6 x 7 x 6 steps of the colour cube (green gets the most)
+static uint8_t cubeIndex(uint32_t r, uint32_t g, uint32_t b){
+  return (r * 5 + 127) / 255 * 42 + (g * 6 + 127) / 255 * 6 + (b * 5 + 127) / 255;
+}
+
+bool thumbFilename(const char* filename, char* out, size_t len){
+  size_t n = strlen(filename);
+  if(n < 4 || n >= len || strcmp(filename + n - 4, ".bmp"))
+    return false;
+  memcpy(out, filename, n - 4);
+  strcpy(out + n - 4, ".tmb");
+  return true;
+}
+
+// RLE8 of one row: runs of 2 or more as (count, index), stretches of
+// differing pixels as absolute blocks (at least 3, padded to 16 bit), then
+// end of line. Returns the encoded length.
+static size_t encodeRow(const uint8_t* row, uint16_t width, uint8_t* out){
+  size_t n = 0;
+  uint16_t x = 0;
+
+  while(x < width){
+    uint16_t run = 1;
+    while(x + run < width && run < 255 && row[x + run] == row[x])
+      run++;
+    if(run >= 2){
+      out[n++] = run;
+      out[n++] = row[x];
+      x += run;
+      continue;
+    }
+    //differing pixels up to the next run
+    uint16_t lit = 1;
+    while(x + lit < width && lit < 255 && !(x + lit + 1 < width && row[x + lit] == row[x + lit + 1]))
+      lit++;
+    if(lit < 3){
+      for(uint16_t i = 0; i < lit; i++){
+        out[n++] = 1;
+        out[n++] = row[x + i];
+      }
+    }
+    else{
+      out[n++] = 0;
+      out[n++] = lit;
+      memcpy(out + n, row + x, lit);
+      n += lit;
+      if(lit & 1)
+        out[n++] = 0;
+    }
+    x += lit;
+  }
+  out[n++] = 0;
+  out[n++] = 0;
+  return n;
+}
+
+bool writeThumbnail(RowSource& src, ByteSink& out){
+  uint16_t leds = src.width();
+  uint32_t rows = src.rows();
+  uint16_t tw, th;
+  uint8_t header[BMP_HEADER_SIZE];
+  uint8_t entry[4];
+  uint8_t encoded[RLE_ROW_MAX];
+  uint32_t data_len = 0;
+  bool ok = true;
+
+  if(leds == 0 || rows == 0 || leds > THUMB_SRC_WIDTH_MAX)
+    return false;
+  //time across, LEDs up, scaled down to THUMB_PIXELS and THUMB_SIDE_MAX
+  float scale = sqrtf((float)THUMB_PIXELS / ((float)rows * leds));
+  if(scale > 1)
+    scale = 1;
+  if(rows * scale > THUMB_SIDE_MAX)
+    scale = (float)THUMB_SIDE_MAX / rows;
+  if(leds * scale > THUMB_SIDE_MAX)
+    scale = (float)THUMB_SIDE_MAX / leds;
+  tw = rows * scale;
+  th = leds * scale;
+  if(tw == 0) tw = 1;
+  if(th == 0) th = 1;
+
+  //one block: thumbnail (bottom-up BMP rows), sums per LED bin, source row.
+  //Aligning the sums stays within THUMB_RAM, THUMB_PIXELS is a multiple of 4
+  size_t thumb_len = ((size_t)tw * th + 3) & ~3;
+  uint8_t* thumb = (uint8_t*)malloc(thumb_len + (size_t)th * 4 * sizeof(uint32_t) + (size_t)leds * 3);
+  if(!thumb)
+    return false;
+  uint32_t* sums = (uint32_t*)(thumb + thumb_len);
+  uint8_t* row = (uint8_t*)(sums + th * 4);
+
+  uint16_t column = 0;
+  memset(sums, 0, th * 4 * sizeof(uint32_t));
+  for(uint32_t r = 0; r < rows && ok; r++){
+    if(!src.readRow(r, row)){
+      ok = false;
+      break;
+    }
+    for(uint16_t i = 0; i < leds; i++){
+      uint32_t* s = sums + (uint32_t)i * th / leds * 4;
+      s[0] += row[i * 3 + 1];     // GRB
+      s[1] += row[i * 3];
+      s[2] += row[i * 3 + 2];
+      s[3]++;
+    }
+    //the column is done when the next row belongs to the next one
+    if(r + 1 == rows || (uint64_t)(r + 1) * tw / rows != column){
+      for(uint16_t y = 0; y < th; y++){
+        uint32_t* s = sums + y * 4;
+        uint32_t n = s[3] ? s[3] : 1;
+        thumb[(uint32_t)y * tw + column] = cubeIndex(s[0] / n, s[1] / n, s[2] / n);
+      }
+      memset(sums, 0, th * 4 * sizeof(uint32_t));
+      column++;
+    }
+  }
+
+  if(ok){
+    //palette of the used colours only, a few hundred bytes less for simple images
+    uint8_t map[THUMB_COLORS];
+    uint8_t used[THUMB_COLORS];
+    uint16_t colors = 0;
+    memset(map, 0xFF, sizeof(map));
+    for(uint32_t i = 0; i < (uint32_t)tw * th; i++){
+      uint8_t c = thumb[i];
+      if(map[c] == 0xFF){
+        map[c] = colors;
+        used[colors++] = c;
+      }
+      thumb[i] = map[c];
+    }
+
+    for(uint16_t y = 0; y < th; y++)
+      data_len += encodeRow(thumb + (uint32_t)y * tw, tw, encoded);
+    data_len += 2;
+
+    uint32_t offset = BMP_HEADER_SIZE + colors * 4;
+    memset(header, 0, sizeof(header));
+    header[0] = 'B'; header[1] = 'M';
+    put32(header + 2, offset + data_len);
+    put32(header + 10, offset);
+    put32(header + 14, 40);
+    put32(header + 18, tw);
+    put32(header + 22, th);             // positive, RLE BMPs are bottom-up
+    put16(header + 26, 1);
+    put16(header + 28, 8);
+    put32(header + 30, BMP_RLE8);
+    put32(header + 34, data_len);
+    put32(header + 46, colors);
+    ok = out.write(header, sizeof(header)) == sizeof(header);
+    for(uint16_t i = 0; i < colors && ok; i++){
+      uint8_t c = used[i];
+      entry[0] = (c % 6) * 255 / 5;         // BGR0
+      entry[1] = (c / 6 % 7) * 255 / 6;
+      entry[2] = (c / 42) * 255 / 5;
+      entry[3] = 0;
+      ok = out.write(entry, 4) == 4;
+    }
+    for(uint16_t y = 0; y < th && ok; y++){
+      size_t n = encodeRow(thumb + (uint32_t)y * tw, tw, encoded);
+      ok = out.write(encoded, n) == n;
+    }
+    //end of bitmap
+    encoded[0] = 0;
+    encoded[1] = 1;
+    ok = ok && out.write(encoded, 2) == 2;
+  }
+  free(thumb);
+  return ok;
+}
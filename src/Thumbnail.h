@@ -0,0 +1,26 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ImageFormat.h"
+
+#define THUMB_PIXELS 4096           // most pixels of a thumbnail
+#define THUMB_SIDE_MAX 256          // longest side, long strokes get a wide flat thumbnail
+#define THUMB_SRC_WIDTH_MAX 1024    // wider images get no thumbnail
+#define THUMB_COLORS 252            // 6 x 7 x 6 colour cube, only the used ones go in the palette
+// most RAM writeThumbnail() allocates: the thumbnail, a sum per LED bin and one source row
+#define THUMB_RAM (THUMB_PIXELS + THUMB_SIDE_MAX * 4 * sizeof(uint32_t) + THUMB_SRC_WIDTH_MAX * 3)
+
+// "/name.bmp" -> "/name.tmb", false if filename is no .bmp or out is too small
+bool thumbFilename(const char* filename, char* out, size_t len);
+
+// Writes a preview of src as an 8 Bit RLE compressed BMP of at most
+// THUMB_PIXELS pixels, with the aspect of the image. It is turned the way the light painting looks: the
+// rows (the time) from left to right, the first LED at the bottom. The rows
+// are read once, in order, and averaged into the thumbnail in RAM, so the
+// image is never held as a whole and no more than THUMB_RAM bytes are
+// allocated. False if src is too wide, the RAM is missing or out failed.
+bool writeThumbnail(RowSource& src, ByteSink& out);
+
+#endif
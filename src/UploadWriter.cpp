@@ -0,0 +1,90 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "UploadWriter.h"
+#include "Crc32.h"
+
+UploadWriter::UploadWriter() : _sink(NULL), _buf(NULL), _len(0), _limit(UPLOAD_BUFFER), _size(0), _written(0),
+    _crc(0), _failed(false) {
+}
+
+UploadWriter::~UploadWriter(){
+  end();
+}
+
+bool UploadWriter::begin(ByteSink* sink, uint32_t offset, uint32_t crc){
+  end();
+  _buf = (uint8_t*)malloc(UPLOAD_BUFFER);
+  if(!_buf)
+    return false;
+  _sink = sink;
+  _len = 0;
+  _size = _written = offset;
+  _crc = crc;
+  _failed = false;
+  //a resumed upload first fills up to the next page, after that every write is aligned
+  _limit = UPLOAD_BUFFER - offset % UPLOAD_PAGE;
+  return true;
+}
+
+bool UploadWriter::write(const uint8_t* data, size_t len){
+  if(!_buf || _failed)
+    return false;
+  while(len > 0){
+    size_t n = _limit - _len;
+    if(n > len)
+      n = len;
+    memcpy(_buf + _len, data, n);
+    _len += n;
+    _size += n;
+    data += n;
+    len -= n;
+    if(_len == _limit && !flush())
+      return false;
+  }
+  return true;
+}
+
+bool UploadWriter::flush(){
+  if(!_buf || _failed)
+    return false;
+  if(_len == 0)
+    return true;
+  if(_sink->write(_buf, _len) != _len){
+    _failed = true;
+    return false;
+  }
+  //the CRC is taken of what really is in the sink, so a resume can trust it
+  _crc = crc32(_buf, _len, _crc);
+  _written += _len;
+  _len = 0;
+  _limit = UPLOAD_BUFFER - _written % UPLOAD_PAGE;
+  return true;
+}
+
+void UploadWriter::end(){
+  free(_buf);
+  _buf = NULL;
+  _sink = NULL;
+  _len = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef UPLOAD_WRITER_H
+#define UPLOAD_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ImageFormat.h"
+
+#define UPLOAD_PAGE 256           // SPIFFS page, writes are aligned to it
+#define UPLOAD_BUFFER 4096        // received data is collected up to this before it is written
+
+// Collects the chunks of an upload in one buffer and writes it out in
+// page aligned pieces of UPLOAD_BUFFER bytes, instead of one small
+// unaligned write per received chunk. Keeps size and CRC32 of everything
+// written so an upload can be checked and resumed at an offset.
+class UploadWriter {
+  public:
+    UploadWriter();
+    ~UploadWriter();
+
+    // sink already holds offset bytes with the given crc (0, 0 for a new file).
+    // False if the buffer can't be allocated
+    bool begin(ByteSink* sink, uint32_t offset = 0, uint32_t crc = 0);
+    bool write(const uint8_t* data, size_t len);
+    bool flush();               // writes what is buffered, false if the sink failed
+    void end();                 // frees the buffer, unflushed data is lost
+
+    uint32_t size() const { return _size; }       // offset plus everything accepted
+    uint32_t written() const { return _written; } // bytes in the sink
+    uint32_t crc() const { return _crc; }         // of the bytes in the sink
+    bool failed() const { return _failed; }
+
+  private:
+    ByteSink* _sink;
+    uint8_t* _buf;
+    size_t _len;
+    size_t _limit;              // fill level which is written, shorter once to align
+    uint32_t _size;
+    uint32_t _written;
+    uint32_t _crc;
+    bool _failed;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+#include "WifiList.h"
+#include <string.h>
+
+void WifiList::add(const char* ssid, int8_t rssi, bool open){
+  uint8_t i;
+
+  //hidden networks have no name to select
+  if(!ssid[0])
+    return;
+  for(i = 0; i < _count; i++){
+    if(!strncmp(_networks[i].ssid, ssid, WIFI_SSID_LEN - 1))
+      break;
+  }
+  if(i < _count){
+    //another access point of the same network
+    if(rssi <= _networks[i].rssi)
+      return;
+  }
+  else if(_count < WIFI_LIST_MAX){
+    i = _count++;
+  }
+  else{
+    //full, replace the weakest if this one is stronger
+    i = _count - 1;
+    if(rssi <= _networks[i].rssi)
+      return;
+  }
+  //move up to keep the list sorted, strongest first
+  while(i > 0 && _networks[i - 1].rssi < rssi){
+    _networks[i] = _networks[i - 1];
+    i--;
+  }
+  Network& n = _networks[i];
+  strncpy(n.ssid, ssid, WIFI_SSID_LEN - 1);
+  n.ssid[WIFI_SSID_LEN - 1] = 0;
+  n.rssi = rssi;
+  n.open = open;
+}
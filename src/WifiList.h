@@ -0,0 +1,45 @@
+#ifndef WIFI_LIST_H
+#define WIFI_LIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define WIFI_LIST_MAX 16            // strongest networks kept
+#define WIFI_SSID_LEN 33            // 32 characters and the terminating 0
+
+// Result of the last WiFi scan, one entry per SSID with its strongest
+// access point, sorted by signal strength. Filled by the scan in loop(), the
+// browse page only reads it.
+class WifiList {
+  public:
+    struct Network {
+      char ssid[WIFI_SSID_LEN];
+      int8_t rssi;            // dBm
+      bool open;              // no encryption
+    };
+
+    WifiList() : _count(0), _scanned_at(0), _valid(false) {}
+
+    // empties the list for the results of a new scan
+    void clear() { _count = 0; }
+    // adds a network or updates its SSID if it is stronger, the weakest one
+    // drops out when the list is full
+    void add(const char* ssid, int8_t rssi, bool open);
+    // the scan which filled the list is done
+    void done(uint32_t now_ms) { _scanned_at = now_ms; _valid = true; }
+
+    uint8_t count() const { return _count; }
+    const Network& at(uint8_t i) const { return _networks[i]; }
+    // scanned less than ttl_ms ago
+    bool fresh(uint32_t now_ms, uint32_t ttl_ms) const { return _valid && now_ms - _scanned_at < ttl_ms; }
+    uint32_t age(uint32_t now_ms) const { return now_ms - _scanned_at; }
+    bool valid() const { return _valid; }
+
+  private:
+    Network _networks[WIFI_LIST_MAX];
+    uint8_t _count;
+    uint32_t _scanned_at;
+    bool _valid;
+};
+
+#endif
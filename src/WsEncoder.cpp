@@ -0,0 +1,41 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+#include "WsEncoder.h"
+
+// UART sends the data bits LSB first and inverted, so e.g. "10" (long high,
+// then short high) is start, 0, 0, 1 | 0, 1, 1, stop = 0b110100
+const uint8_t wsUartCodes[4] = {
+  0b110111,   // 00
+  0b000111,   // 01
+  0b110100,   // 10
+  0b000100    // 11
+};
+
+void wsEncodeUart(const uint8_t* src, size_t len, uint8_t* dst){
+  while(len--){
+    uint8_t v = *src++;
+    *dst++ = wsUartCodes[(v >> 6) & 3];
+    *dst++ = wsUartCodes[(v >> 4) & 3];
+    *dst++ = wsUartCodes[(v >> 2) & 3];
+    *dst++ = wsUartCodes[v & 3];
+  }
+}
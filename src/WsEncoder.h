@@ -0,0 +1,25 @@
+#ifndef WS_ENCODER_H
+#define WS_ENCODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// WS2812 bits sent by a UART: at 3.2 MBaud, 6N1 with inverted TX every UART
+// frame (start bit, 6 data bits, stop bit) is 8 * 312.5ns, which is exactly
+// two WS2812 bits of 1.25us. The inverted start bit is the leading high of
+// the first WS2812 bit, the inverted stop bit the trailing low of the second.
+#define WS_UART_BAUD 3200000
+#define WS_UART_BYTES_PER_BYTE 4    // UART bytes for one pixel byte
+#define WS_BYTE_US 10               // transmit time of one pixel byte
+#define WS_LATCH_US 60              // low time which latches the data
+#define WS_BIT_NS 1250              // one WS2812 bit when it is bit-banged
+#define WS_T0H_NS 400               // high time of a 0
+#define WS_T1H_NS 800               // high time of a 1
+
+// UART data for two WS2812 bits (MSB first), indexed by their value
+extern const uint8_t wsUartCodes[4];
+
+// encodes len pixel bytes into len * WS_UART_BYTES_PER_BYTE UART bytes
+void wsEncodeUart(const uint8_t* src, size_t len, uint8_t* dst);
+
+#endif
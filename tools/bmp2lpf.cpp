@@ -0,0 +1,239 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+// Converts BMPs (24/32 Bit, 8/4 Bit palette, RLE) to the .lpf strip frame format on the PC, e.g. to put
+// preconverted images into the data folder. Build with:
+//   g++ -O2 -Isrc -o bmp2lpf tools/bmp2lpf.cpp src/ImageFormat.cpp
+// Usage: bmp2lpf [-v] input.bmp [output.lpf]
+//   -v  read the written file back and compare every row with the BMP, which
+//       is decoded for this without the reader of the controller
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ImageFormat.h"
+#include "host/StdioStream.h"
+
+// little endian fields of a file in memory, bytes past its end read as 0
+static uint32_t get(const uint8_t* data, size_t len, size_t pos, int bytes){
+  uint32_t v = 0;
+  for(int b = bytes - 1; b >= 0; b--)
+    v = v << 8 | (pos + b < len ? data[pos + b] : 0);
+  return v;
+}
+
+static uint8_t* loadFile(const char* name, size_t* len){
+  FILE* f = fopen(name, "rb");
+  uint8_t* data = NULL;
+  if(!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if((data = (uint8_t*)malloc(*len + 1)) && fread(data, 1, *len, f) != *len){
+    free(data);
+    data = NULL;
+  }
+  fclose(f);
+  return data;
+}
+
+// Decodes the whole BMP from its bytes, pixel by pixel and without
+// ImageSource, so a bug in the reader can't pass on both sides of -v. The
+// result is GRB like the .lpf, row 0 at the bottom. NULL if the BMP is not
+// one the reader takes
+static uint8_t* decodeBmp(const uint8_t* bmp, size_t len, uint32_t* width, uint32_t* rows){
+  int32_t w = get(bmp, len, 18, 4), h = get(bmp, len, 22, 4);
+  uint32_t bpp = get(bmp, len, 28, 2), compression = get(bmp, len, 30, 4), colors = get(bmp, len, 46, 4);
+  uint32_t offset = get(bmp, len, 10, 4);
+  bool rle = compression == 1 || compression == 2;
+  uint8_t palette[256][3];
+  uint8_t* out;
+
+  if(len < 54 || bmp[0] != 'B' || bmp[1] != 'M' || get(bmp, len, 26, 2) != 1 || w <= 0 || w > 0xFFFF || h == 0 || h == INT32_MIN)
+    return NULL;
+  if(compression == 0 && bpp != 4 && bpp != 8 && bpp != 24 && bpp != 32)
+    return NULL;
+  if(rle && (bpp != (compression == 1 ? 8u : 4u) || h < 0))
+    return NULL;
+  if(compression == 3 && (bpp != 32 || get(bmp, len, 54, 4) != 0xFF0000 || get(bmp, len, 58, 4) != 0xFF00 || get(bmp, len, 62, 4) != 0xFF))
+    return NULL;
+  if(compression > 3)
+    return NULL;
+  *width = w;
+  *rows = h < 0 ? -h : h;
+
+  //unused palette entries are black
+  memset(palette, 0, sizeof(palette));
+  if(bpp <= 8){
+    uint32_t pos = 14 + get(bmp, len, 14, 4);
+    if(colors == 0 || colors > (1u << bpp))
+      colors = 1 << bpp;
+    for(uint32_t i = 0; i < colors; i++){
+      palette[i][0] = get(bmp, len, pos + i * 4 + 1, 1);
+      palette[i][1] = get(bmp, len, pos + i * 4 + 2, 1);
+      palette[i][2] = get(bmp, len, pos + i * 4, 1);
+    }
+  }
+  if((out = (uint8_t*)calloc((size_t)*width * *rows, 3)) == NULL)
+    return NULL;
+
+  if(!rle){
+    uint32_t stride = ((*width * bpp + 31) / 32) * 4;
+    for(uint32_t y = 0; y < *rows; y++){
+      size_t line = offset + (size_t)y * stride;
+      uint8_t* dst = out + (size_t)(h < 0 ? *rows - 1 - y : y) * *width * 3;
+      for(uint32_t x = 0; x < *width; x++, dst += 3){
+        if(bpp >= 24){
+          size_t p = line + x * (bpp / 8);
+          dst[0] = get(bmp, len, p + 1, 1);
+          dst[1] = get(bmp, len, p + 2, 1);
+          dst[2] = get(bmp, len, p, 1);
+        }
+        else{
+          uint32_t index = bpp == 8 ? get(bmp, len, line + x, 1) : get(bmp, len, line + x / 2, 1) >> (x & 1 ? 0 : 4) & 0x0F;
+          memcpy(dst, palette[index], 3);
+        }
+      }
+    }
+    return out;
+  }
+
+  //RLE: the cursor moves over the image, pixels it never reaches stay black
+  bool rle4 = compression == 2;
+  uint32_t x = 0, y = 0;
+  size_t pos = offset;
+  while(pos + 1 < len && y < *rows){
+    uint32_t n = bmp[pos++], v = bmp[pos++];
+    if(n > 0){
+      for(uint32_t i = 0; i < n; i++, x++)
+        if(x < *width)
+          memcpy(out + ((size_t)y * *width + x) * 3, palette[rle4 ? (i & 1 ? v & 0x0F : v >> 4) : v], 3);
+    }
+    else if(v == 0){
+      x = 0;
+      y++;
+    }
+    else if(v == 1){
+      break;
+    }
+    else if(v == 2){
+      x += get(bmp, len, pos, 1);
+      y += get(bmp, len, pos + 1, 1);
+      pos += 2;
+    }
+    else{
+      for(uint32_t i = 0; i < v; i++, x++){
+        uint32_t index = rle4 ? get(bmp, len, pos + i / 2, 1) >> (i & 1 ? 0 : 4) & 0x0F : get(bmp, len, pos + i, 1);
+        if(x < *width)
+          memcpy(out + ((size_t)y * *width + x) * 3, palette[index], 3);
+      }
+      pos += ((rle4 ? (v + 1) / 2 : v) + 1) & ~1u;
+    }
+  }
+  return out;
+}
+
+// Compares the written .lpf byte for byte with the BMP decoded on its own,
+// the .lpf header is checked against the format description in ImageFormat.h
+static bool verify(const char* bmpname, const char* lpfname){
+  size_t bmp_len = 0, lpf_len = 0;
+  uint8_t* bmp = loadFile(bmpname, &bmp_len);
+  uint8_t* lpf = loadFile(lpfname, &lpf_len);
+  uint8_t* ref = NULL;
+  uint32_t width = 0, rows = 0, header = 0;
+  bool ok = bmp && lpf && (ref = decodeBmp(bmp, bmp_len, &width, &rows)) != NULL;
+
+  if(ok){
+    header = get(lpf, lpf_len, 4, 2);
+    ok = lpf_len >= LPF_HEADER_SIZE && !memcmp(lpf, LPF_MAGIC, 4) && header >= LPF_HEADER_SIZE
+         && get(lpf, lpf_len, 6, 2) == width && get(lpf, lpf_len, 8, 4) == rows && lpf[12] == 3
+         && lpf[13] == LPF_ORDER_GRB && get(lpf, lpf_len, 14, 2) == LPF_GAMMA_LINEAR
+         && lpf_len == header + (size_t)width * rows * 3;
+    if(!ok) fprintf(stderr, "Header doesn't match the BMP\n");
+  }
+  for(uint32_t row = 0; ok && row < rows; row++){
+    ok = !memcmp(lpf + header + (size_t)row * width * 3, ref + (size_t)row * width * 3, width * 3);
+    if(!ok) fprintf(stderr, "Row %u differs\n", (unsigned)row);
+  }
+  free(ref);
+  free(lpf);
+  free(bmp);
+  return ok;
+}
+
+int main(int argc, char** argv){
+  bool check = false;
+  char outname[1024];
+  int arg = 1;
+
+  if(arg < argc && !strcmp(argv[arg], "-v")){
+    check = true;
+    arg++;
+  }
+  if(arg >= argc){
+    fprintf(stderr, "Usage: %s [-v] input.bmp [output.lpf]\n", argv[0]);
+    return 2;
+  }
+  const char* inname = argv[arg++];
+  if(arg < argc)
+    snprintf(outname, sizeof(outname), "%s", argv[arg]);
+  else if(!lpfFilename(inname, outname, sizeof(outname))){
+    fprintf(stderr, "%s: input must end in .bmp\n", inname);
+    return 2;
+  }
+
+  FILE* in = fopen(inname, "rb");
+  if(!in){
+    perror(inname);
+    return 1;
+  }
+  StdioSource src(in);
+  ImageSource img;
+  if(!img.open(&src) || img.type() != IMAGE_BMP){
+    fprintf(stderr, "%s: not a supported BMP\n", inname);
+    fclose(in);
+    return 1;
+  }
+
+  FILE* out = fopen(outname, "wb");
+  if(!out){
+    perror(outname);
+    fclose(in);
+    return 1;
+  }
+  StdioSink sink(out);
+  uint8_t* rowbuf = (uint8_t*)malloc(img.width() * 3);
+  bool ok = writeLpf(img, sink, rowbuf);
+  free(rowbuf);
+  fclose(in);
+  if(fclose(out) != 0) ok = false;
+  if(!ok){
+    fprintf(stderr, "%s: conversion failed\n", outname);
+    return 1;
+  }
+  printf("%s: %u x %u -> %s\n", inname, (unsigned)img.width(), (unsigned)img.rows(), outname);
+
+  if(check && !verify(inname, outname)){
+    fprintf(stderr, "%s: verification failed\n", outname);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Checks the BMP reader on the PC: the same test image is written in every
+// format the controller takes (4 and 8 Bit palette, RLE4, RLE8, 24 Bit,
+// 32 Bit plain and BI_BITFIELDS, bottom-up and top-down) and read back with
+// ImageSource::readRow forwards, backwards and skipping around. Every row
+// must match the expected GRB row. The RLE data uses runs, literal runs,
+// deltas, early ends of line and an early end of bitmap. Build with:
+//   g++ -O2 -Wall -Isrc -o bmpcheck tools/bmpcheck.cpp src/ImageFormat.cpp
+// Usage: bmpcheck [-s WIDTHxROWS]
+//   -s WxR  check this size instead of the built in set
+// The exit code is 1 if a row is wrong.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ImageFormat.h"
+
+#define COLORS 16
+
+struct Format {
+  const char* name;
+  uint16_t bpp;
+  uint32_t compression;     // 0 plain, 1 RLE8, 2 RLE4, 3 BI_BITFIELDS
+  bool top_down;
+};
+
+static const Format formats[] = {
+  { "4 Bit",           4,  0, false },
+  { "4 Bit top-down",  4,  0, true  },
+  { "8 Bit",           8,  0, false },
+  { "8 Bit top-down",  8,  0, true  },
+  { "RLE4",            4,  2, false },
+  { "RLE8",            8,  1, false },
+  { "24 Bit",          24, 0, false },
+  { "24 Bit top-down", 24, 0, true  },
+  { "32 Bit",          32, 0, false },
+  { "32 Bit bitfields", 32, 3, false },
+  { "32 Bit bitfields top-down", 32, 3, true },
+};
+
+// BGRX, entry 0 is black so the RLE deltas and early line ends are black too
+static uint8_t palette[COLORS][4];
+
+static void makePalette(){
+  for(int i = 1; i < COLORS; i++){
+    palette[i][0] = i * 16 + 3;
+    palette[i][1] = 255 - i * 13;
+    palette[i][2] = (i * 37) & 0xFF;
+  }
+}
+
+// Palette index of pixel x in row y (row 0 is the bottom). Runs of three,
+// every fourth row without runs, black tails, black rows and a black top so
+// the encoder has something for each RLE escape.
+static uint8_t pixel(uint32_t x, uint32_t y, uint32_t width, uint32_t rows){
+  if(rows > 4 && y >= rows - 2)
+    return 0;
+  if(y % 7 == 4 || y % 7 == 5)
+    return 0;
+  if(y % 5 == 2 && x < 6)
+    return 0;
+  if(y % 3 == 1 && x >= width / 2)
+    return 0;
+  if(y % 4 == 1)
+    return 1 + (x * 7 + y) % (COLORS - 1);
+  return 1 + (x / 3 + y) % (COLORS - 1);
+}
+
+static void put16(uint8_t* p, uint16_t v){
+  p[0] = v; p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v){
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+// Growing output buffer for the file
+struct Buffer {
+  uint8_t* data;
+  size_t len, size;
+  Buffer() : data(NULL), len(0), size(0) {}
+  ~Buffer() { free(data); }
+  void put(uint8_t v){
+    if(len == size){
+      size = size ? size * 2 : 1024;
+      data = (uint8_t*)realloc(data, size);
+    }
+    data[len++] = v;
+  }
+  void put2(uint8_t a, uint8_t b) { put(a); put(b); }
+};
+
+// RLE4 packs two pixels in a byte, high nibble first
+static void putLiteral(Buffer& out, const uint8_t* idx, int n, bool rle4){
+  int bytes = rle4 ? (n + 1) / 2 : n;
+  out.put2(0, n);
+  for(int i = 0; i < n; i += rle4 ? 2 : 1)
+    out.put(rle4 ? idx[i] << 4 | (i + 1 < n ? idx[i + 1] : 0) : idx[i]);
+  if(bytes & 1)
+    out.put(0);
+}
+
+static void encodeRle(Buffer& out, uint32_t width, uint32_t rows, bool rle4){
+  uint8_t* idx = (uint8_t*)malloc(width);
+
+  for(uint32_t y = 0; y < rows; y++){
+    uint32_t end = 0, x = 0;
+    for(uint32_t i = 0; i < width; i++){
+      idx[i] = pixel(i, y, width, rows);
+      if(idx[i])
+        end = i + 1;
+    }
+    // leading black is skipped with a delta to the right
+    while(x < end && !idx[x])
+      x++;
+    if(x >= 4 && x < 256)
+      out.put2(0, 2), out.put2(x, 0);
+    else
+      x = 0;
+    while(x < end){
+      uint32_t run = 1, lit = 1;
+      while(x + run < end && run < 255 && idx[x + run] == idx[x])
+        run++;
+      if(run >= 2){
+        out.put2(run, rle4 ? idx[x] << 4 | idx[x] : idx[x]);
+        x += run;
+        continue;
+      }
+      while(x + lit < end && lit < 255 && (x + lit + 1 >= end || idx[x + lit] != idx[x + lit + 1]))
+        lit++;
+      if(lit >= 3){
+        putLiteral(out, idx + x, lit, rle4);
+        x += lit;
+      }
+      else{
+        out.put2(1, rle4 ? idx[x] << 4 : idx[x]);
+        x++;
+      }
+    }
+    // black rows after this one are skipped with a delta up from the start
+    // of the next row (a delta keeps the column), black rows up to the top
+    // with the end of bitmap
+    uint32_t blank = 0;
+    while(y + 1 + blank < rows){
+      uint32_t i = 0;
+      while(i < width && !pixel(i, y + 1 + blank, width, rows))
+        i++;
+      if(i < width)
+        break;
+      blank++;
+    }
+    if(y + 1 + blank >= rows){
+      out.put2(0, 1);
+      break;
+    }
+    out.put2(0, 0);
+    if(blank > 0 && blank < 256){
+      out.put2(0, 2), out.put2(0, blank);
+      y += blank;
+    }
+  }
+  free(idx);
+}
+
+// writes the test image as a BMP of format f
+static void makeBmp(Buffer& out, const Format& f, uint32_t width, uint32_t rows){
+  uint32_t colors = f.bpp <= 8 ? COLORS : 0;
+  uint32_t masks = f.compression == 3 ? 12 : 0;
+  uint32_t offset = 54 + masks + colors * 4;
+  uint32_t stride = ((width * f.bpp + 31) / 32) * 4;
+  uint8_t header[54];
+
+  memset(header, 0, sizeof(header));
+  for(size_t i = 0; i < offset; i++)
+    out.put(0);
+  if(f.compression == 3){
+    put32(out.data + 54, 0xFF0000);
+    put32(out.data + 58, 0xFF00);
+    put32(out.data + 62, 0xFF);
+  }
+  // the 4 Bit image leaves the colour count at 0, which means all of them
+  if(colors)
+    memcpy(out.data + 54 + masks, palette, COLORS * 4);
+
+  if(f.compression == 1 || f.compression == 2){
+    encodeRle(out, width, rows, f.compression == 2);
+  }
+  else{
+    for(uint32_t i = 0; i < rows; i++){
+      uint32_t y = f.top_down ? rows - 1 - i : i;
+      size_t start = out.len;
+      for(uint32_t x = 0; x < width; x++){
+        uint8_t v = pixel(x, y, width, rows);
+        if(f.bpp == 4){
+          if(x & 1)
+            out.data[out.len - 1] |= v;
+          else
+            out.put(v << 4);
+        }
+        else if(f.bpp == 8){
+          out.put(v);
+        }
+        else{
+          out.put(palette[v][0]); out.put(palette[v][1]); out.put(palette[v][2]);
+          if(f.bpp == 32)
+            out.put(0x80);          // alpha, ignored
+        }
+      }
+      while(out.len - start < stride)
+        out.put(0);
+    }
+  }
+
+  header[0] = 'B'; header[1] = 'M';
+  put32(header + 2, out.len);
+  put32(header + 10, offset);
+  put32(header + 14, 40);
+  put32(header + 18, width);
+  put32(header + 22, f.top_down ? -(int32_t)rows : rows);
+  put16(header + 26, 1);
+  put16(header + 28, f.bpp);
+  put32(header + 30, f.compression);
+  put32(header + 34, out.len - offset);
+  put32(header + 46, f.bpp == 8 ? COLORS : 0);
+  memcpy(out.data, header, sizeof(header));
+}
+
+// compares readRow(row) with the expected GRB row, false and a message if it differs
+static bool checkRow(ImageSource& img, uint32_t row, uint8_t* buf, const char* name, const char* pass){
+  uint32_t width = img.width();
+
+  if(!img.readRow(row, buf)){
+    printf("%s %s: row %u can't be read\n", name, pass, (unsigned)row);
+    return false;
+  }
+  for(uint32_t x = 0; x < width; x++){
+    const uint8_t* c = palette[pixel(x, row, width, img.rows())];
+    const uint8_t* p = buf + x * 3;
+    if(p[0] != c[1] || p[1] != c[2] || p[2] != c[0]){
+      printf("%s %s: row %u pixel %u is %02x%02x%02x instead of %02x%02x%02x (GRB)\n", name, pass,
+             (unsigned)row, (unsigned)x, p[0], p[1], p[2], c[1], c[2], c[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// writes and reads back one format at one size, false if a row is wrong
+static bool check(const Format& f, uint32_t width, uint32_t rows){
+  Buffer bmp;
+  MemorySource mem;
+  ImageSource img;
+  char name[64];
+  bool ok = true;
+
+  snprintf(name, sizeof(name), "%s %ux%u", f.name, (unsigned)width, (unsigned)rows);
+  makeBmp(bmp, f, width, rows);
+  mem.set(bmp.data, bmp.len);
+  if(!img.open(&mem) || img.width() != width || img.rows() != rows || img.bitsPerPixel() != f.bpp){
+    printf("%s: can't be opened\n", name);
+    return false;
+  }
+  // one byte more so a write past the row shows
+  uint8_t* buf = (uint8_t*)malloc(width * 3 + 1);
+  buf[width * 3] = 0xA5;
+
+  for(uint32_t r = 0; ok && r < rows; r++)
+    ok = checkRow(img, r, buf, name, "forward");
+  for(uint32_t r = rows; ok && r > 0; r--)
+    ok = checkRow(img, r - 1, buf, name, "backward");
+  // a stride that doesn't divide the rows visits all of them out of order
+  uint32_t step = rows > 7 && rows % 7 ? 7 : 1;
+  for(uint32_t i = 0, r = 0; ok && i < rows; i++, r = (r + step) % rows)
+    ok = checkRow(img, r, buf, name, "skipping");
+  if(ok && img.readRow(rows, buf)){
+    printf("%s: row %u past the end was read\n", name, (unsigned)rows);
+    ok = false;
+  }
+  if(ok && buf[width * 3] != 0xA5){
+    printf("%s: readRow wrote past the row\n", name);
+    ok = false;
+  }
+  if(ok)
+    printf("%-40s %6u bytes, ok\n", name, (unsigned)bmp.len);
+  free(buf);
+  return ok;
+}
+
+// RLE images can't be stored top-down, the reader has to refuse them
+static bool checkRleTopDown(){
+  Format f = { "RLE8 top-down", 8, 1, false };
+  Buffer bmp;
+  MemorySource mem;
+  ImageSource img;
+
+  makeBmp(bmp, f, 8, 8);
+  put32(bmp.data + 22, -8);
+  mem.set(bmp.data, bmp.len);
+  if(img.open(&mem)){
+    printf("RLE8 top-down: opened, should be refused\n");
+    return false;
+  }
+  printf("%-40s refused, ok\n", "RLE8 top-down");
+  return true;
+}
+
+int main(int argc, char** argv){
+  static const uint32_t sizes[][2] = { {1, 1}, {2, 3}, {5, 9}, {37, 20}, {144, 50}, {300, 31} };
+  unsigned width = 0, rows = 0;
+  int failed = 0;
+
+  for(int i = 1; i < argc; i++){
+    if(!strcmp(argv[i], "-s") && i + 1 < argc && sscanf(argv[++i], "%ux%u", &width, &rows) == 2 && width > 0 && width <= 0xFFFF && rows > 0)
+      continue;
+    fprintf(stderr, "Usage: %s [-s WxR]\n", argv[0]);
+    return 2;
+  }
+  makePalette();
+  for(size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++){
+    if(width){
+      failed += !check(formats[f], width, rows);
+      continue;
+    }
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+      failed += !check(formats[f], sizes[s][0], sizes[s][1]);
+  }
+  failed += !checkRleTopDown();
+  printf("%d failed\n", failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+
+// Times the BGR to GRB conversion of BMP rows on the PC: the row path the
+// sketch used to take (the row into a buffer, then setPixelColor for every
+// pixel into the NeoPixel buffer) against the one it takes now (the row
+// straight into the strip buffer, then convertBgrRow in place), once without
+// and once with the colour table. Both must give the same strip buffer.
+// Build with:
+//   g++ -O2 -Wall -Isrc -o convbench tools/convbench.cpp src/ImageFormat.cpp src/ColorLut.cpp
+// Usage: convbench [-n LEDS] [-r ROWS]
+//   -n LEDS strip length (default 144)
+//   -r ROWS rows converted on each path (default 100000)
+// The exit code is 1 if the two paths give different pixels.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ImageFormat.h"
+#include "ColorLut.h"
+#include "host/TestBmp.h"
+
+static uint64_t realMicros(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Stand-in for the Adafruit_NeoPixel pixel buffer of a GRB strip, the way the
+// sketch filled it before the rows were converted in place
+class NeoPixelBuffer {
+  public:
+    NeoPixelBuffer(uint16_t n) : numLEDs(n), brightness(0), rOffset(1), gOffset(0), bOffset(2) { pixels = (uint8_t*)calloc(n, 3); }
+    ~NeoPixelBuffer() { free(pixels); }
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) __attribute__((noinline));
+    uint16_t numLEDs;
+    uint8_t brightness;
+    uint8_t rOffset, gOffset, bOffset;
+    uint8_t* pixels;
+};
+
+void NeoPixelBuffer::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b){
+  if(n < numLEDs){
+    if(brightness){
+      r = (r * brightness) >> 8;
+      g = (g * brightness) >> 8;
+      b = (b * brightness) >> 8;
+    }
+    uint8_t* p = &pixels[n * 3];
+    p[rOffset] = r;
+    p[gOffset] = g;
+    p[bOffset] = b;
+  }
+}
+
+// Times count rows through the old path (the BMP row into a buffer, then
+// setPixelColor for every pixel) and the new one (the row straight into the
+// strip buffer, then convertBgrRow in place), once without and once with the
+// colour table. Both must give the same strip buffer.
+static int benchConvert(uint16_t leds, uint32_t count){
+  static const uint32_t rows = 64;
+  size_t len;
+  uint8_t* bmp = makeBmp(leds, rows, &len);
+  uint32_t stride = (leds * 3 + 3) & ~3;
+  uint8_t* sdbuffer = (uint8_t*)malloc(leds * 3);
+  uint8_t* direct = (uint8_t*)malloc(leds * 3 + 4);     // malloc'd like the strip buffer, so word aligned
+  uint8_t gamma8[256];
+  NeoPixelBuffer strip(leds);
+  ColorLut lut;
+  uint32_t errors = 0, sum = 0;
+
+  lut.build(280, 255, 255, 255, 255, false);
+  for(int i = 0; i < 256; i++)
+    gamma8[i] = i * i / 255;
+  for(int table = 0; table < 2; table++){
+    uint64_t old_us, new_us, start;
+
+    start = realMicros();
+    for(uint32_t r = 0; r < count; r++){
+      memcpy(sdbuffer, bmp + 54 + (r % rows) * stride, leds * 3);
+      const uint8_t* p = sdbuffer;
+      if(table){
+        for(uint16_t i = 0; i < leds; i++, p += 3)
+          strip.setPixelColor(i, gamma8[p[2]], gamma8[p[1]], gamma8[p[0]]);
+      }
+      else{
+        for(uint16_t i = 0; i < leds; i++, p += 3)
+          strip.setPixelColor(i, p[2], p[1], p[0]);
+      }
+      sum += strip.pixels[r % (leds * 3)];
+    }
+    old_us = realMicros() - start;
+
+    start = realMicros();
+    for(uint32_t r = 0; r < count; r++){
+      memcpy(direct, bmp + 54 + (r % rows) * stride, leds * 3);
+      convertBgrRow(direct, leds);
+      if(table)
+        lut.apply(direct, leds, 0);
+      sum += direct[r % (leds * 3)];
+    }
+    new_us = realMicros() - start;
+
+    //the last row of both must be the same, without the tables
+    if(!table && memcmp(direct, strip.pixels, leds * 3))
+      errors++;
+    printf("%-13s setPixelColor %7.1f ns/row, convertBgrRow %7.1f ns/row, %.1fx (%u LEDs, %u rows)\n",
+           table ? "With table:" : "Conversion:", old_us * 1e3 / count, new_us * 1e3 / count,
+           new_us ? (double)old_us / new_us : 0.0, (unsigned)leds, (unsigned)count);
+  }
+  printf("Result:       %s (%u)\n", errors ? "rows differ" : "same rows", (unsigned)(sum & 0xFF));
+  free(direct);
+  free(sdbuffer);
+  free(bmp);
+  return errors ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+  unsigned leds = 144, rows = 100000;
+
+  for(int i = 1; i < argc; i++){
+    if(!strcmp(argv[i], "-n") && i + 1 < argc && (leds = atoi(argv[++i])) > 0 && leds <= 0xFFFF)
+      continue;
+    if(!strcmp(argv[i], "-r") && i + 1 < argc && (rows = atoi(argv[++i])) > 0)
+      continue;
+    fprintf(stderr, "Usage: %s [-n leds] [-r rows]\n", argv[0]);
+    return 2;
+  }
+  return benchConvert(leds, rows);
+}
@@ -0,0 +1,499 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+// Runs the row path of a drawing (RowPipeline with LineScheduler, ColorLut
+// and RowRing) on the PC with a simulated clock, to see what a change costs
+// without flashing the stick. Waiting only advances the simulated clock, the
+// work in between is measured in real time, so a draw of minutes takes
+// milliseconds and the row cost is the PC's, not the ESP's. Build with:
+//   g++ -O2 -Isrc -o drawsim tools/drawsim.cpp src/RowPipeline.cpp src/LineScheduler.cpp
+//       src/ColorLut.cpp src/RowRing.cpp src/ImageFormat.cpp src/Resampler.cpp src/Pattern.cpp src/Metrics.cpp
+//       src/StripSegments.cpp src/WsEncoder.cpp src/Playlist.cpp
+// Usage: drawsim [options] image.bmp|image.lpf
+//        drawsim [options] -s WIDTHxROWS
+//        drawsim [options] -p PATTERN
+//        drawsim [options] -l LIST
+//   -s WxR  draw a generated 24 Bit BMP from RAM instead of a file
+//   -p NAME draw a pattern (rainbow, gradient, chase, plasma, text), 500 rows
+//   -x TEXT text of the text pattern
+//   -l LIST draw a playlist of patterns or image files, each entry
+//           NAME[:LINE_MS[:GAP_MS[:REPEAT]]], e.g. rainbow:0:500,gradient
+//   -n LEDS strip length (default 60)
+//   -t MS   line time, 0 as fast as the strip takes the rows (default 20)
+//   -r N    rows read ahead, 0 reads each row into the strip buffer (default 4)
+//   -k N    lines per row (stretch, default 1)
+//   -m MODE repeat or blend stretched rows (default blend)
+//   -f MODE scale to the strip: off, nearest, bilinear or box (default box)
+//   -w US   time the web server takes per loop() pass between rows (default 0)
+//   -j US   time of a long request (an upload, a config store, a big file),
+//           which the sketch refuses with a 503 while drawing (default 0, none)
+//   -e N    rows between two long requests (default 50)
+//   -a      serve the long requests instead of refusing them, to see what a
+//           handler of -j us does to the lines
+//   -o FILE write every shown row to FILE, one strip buffer after the other
+//   -i N    run the draw N times and report the fastest (default 1)
+//   -g SEGS split the row on parallel strips like the Parallel output, e.g.
+//           14:0:30,12:30:30r, and check every encoded row against the row
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "RowPipeline.h"
+#include "Pattern.h"
+#include "Playlist.h"
+#include "StripSegments.h"
+#include "WsEncoder.h"
+#include "host/StdioStream.h"
+#include "host/TestBmp.h"
+
+static uint64_t real_start;
+static uint64_t waited;             // us the simulated clock is ahead of the real one
+
+static uint64_t realMicros(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t simClock(){
+  return (uint32_t)(realMicros() - real_start + waited);
+}
+
+static void simWait(uint32_t us){
+  waited += us;
+}
+
+// Counts what the image reader asks for, to see the read pattern
+class CountingSource : public ByteSource {
+  public:
+    CountingSource(ByteSource& src) : bytes(0), reads(0), seeks(0), _src(src) {}
+    size_t read(uint8_t* buf, size_t len) { reads++; len = _src.read(buf, len); bytes += len; return len; }
+    bool seek(uint32_t pos) { seeks++; return _src.seek(pos); }
+    uint32_t position() { return _src.position(); }
+    uint32_t bytes, reads, seeks;
+  private:
+    ByteSource& _src;
+};
+
+// Times every row read (or computed for a pattern)
+class TimedSource : public RowSource {
+  public:
+    TimedSource(RowSource& src) : total(0), max(0), _src(src) {}
+    uint16_t width() const { return _src.width(); }
+    uint32_t rows() const { return _src.rows(); }
+    uint32_t linePeriod(uint32_t row) const { return _src.linePeriod(row); }
+    bool readRow(uint32_t row, uint8_t* dst){
+      uint64_t start = realMicros();
+      bool ok = _src.readRow(row, dst);
+      uint32_t us = realMicros() - start;
+      total += us;
+      if(us > max) max = us;
+      return ok;
+    }
+    uint64_t total;
+    uint32_t max;
+  private:
+    RowSource& _src;
+};
+
+// Takes the place of the strip, records when each row was shown
+class RecordingOutput : public StripOutput {
+  public:
+    RecordingOutput(FILE* out) : shows(0), first(0), last(0), max_gap(0), min_gap(0xFFFFFFFF), max_black(0), encode_us(0), errors(0),
+                                 _buf(NULL), _out(out), _encoder(NULL), _segments(NULL), _count(0), _black(false), _black_start(0) {}
+    ~RecordingOutput() { end(); }
+    bool begin(uint16_t leds, uint8_t pin) { _leds = leds; _buf = (uint8_t*)calloc(leds, 3); return _buf != NULL; }
+    void end() { free(_buf); _buf = NULL; }
+    uint8_t* pixels() { return _buf; }
+    void show(){
+      uint32_t now = simClock();
+      if(shows == 0)
+        first = now;
+      else{
+        if(now - last > max_gap) max_gap = now - last;
+        if(now - last < min_gap) min_gap = now - last;
+      }
+      last = now;
+      shows++;
+      //runs of black rows, the gaps of a playlist
+      bool black = true;
+      for(uint32_t i = 0; i < _leds * 3u && black; i++)
+        black = _buf[i] == 0;
+      if(black && !_black)
+        _black_start = now;
+      if(!black && _black && now - _black_start > max_black)
+        max_black = now - _black_start;
+      _black = black;
+      if(_out)
+        fwrite(_buf, 3, _leds, _out);
+      if(_encoder){
+        uint64_t start = realMicros();
+        _encoder->encode(_buf);
+        encode_us += realMicros() - start;
+        check();
+      }
+      //the strip takes the row like show() on the ESP, which waits for it
+      simWait(_encoder ? _encoder->bits() * WS_BIT_NS / 1000 + WS_LATCH_US : (uint32_t)_leds * 3 * WS_BYTE_US + WS_LATCH_US);
+    }
+    void setEncoder(ParallelEncoder* encoder, const StripSegment* segments, uint8_t count){
+      _encoder = encoder;
+      _segments = segments;
+      _count = count;
+    }
+    uint32_t shows, first, last, max_gap, min_gap;
+    uint32_t max_black;         // us of the longest run of black rows between two lit ones
+    uint64_t encode_us;
+    uint32_t errors;            // wrong bits in the planes
+  private:
+    // what each pin sends must be its segment of the row, then zeros
+    void check(){
+      const uint16_t* planes = _encoder->planes();
+      uint32_t bytes = _encoder->bits() / 8;
+      for(uint32_t i = 0; i < bytes; i++)
+        for(int b = 0; b < 8; b++)
+          if(planes[i * 8 + b] & ~_encoder->pins())
+            errors++;
+      for(uint8_t s = 0; s < _count; s++){
+        const StripSegment& seg = _segments[s];
+        for(uint32_t i = 0; i < bytes; i++){
+          uint8_t sent = 0;
+          for(int b = 0; b < 8; b++)
+            sent = (sent << 1) | ((planes[i * 8 + b] >> seg.pin) & 1);
+          uint32_t led = i / 3;
+          uint8_t want = 0;
+          if(led < seg.leds)
+            want = _buf[(seg.offset + (seg.reverse ? seg.leds - 1 - led : led)) * 3 + i % 3];
+          if(sent != want)
+            errors++;
+        }
+      }
+    }
+    uint8_t* _buf;
+    FILE* _out;
+    ParallelEncoder* _encoder;
+    const StripSegment* _segments;
+    uint8_t _count;
+    bool _black;
+    uint32_t _black_start;
+};
+
+// Opens the playlist entries like the DrawEngine: a pattern by its name,
+// anything else as an image file
+class FileOpener : public PlaylistSource::Opener {
+  public:
+    FileOpener(uint16_t leds, const PatternParams& params) : _leds(leds), _params(params), _file(NULL), _src(NULL), _pattern(NULL) {}
+    ~FileOpener() { closeEntry(); }
+    RowSource* openEntry(const PlaylistEntry& entry, uint32_t line_us){
+      closeEntry();
+      if((_pattern = createPattern(entry.name)) != NULL){
+        _pattern->begin(_leds, 500, line_us, _params);
+        return _pattern;
+      }
+      if((_file = fopen(entry.name, "rb")) == NULL)
+        return NULL;
+      _src = new StdioSource(_file);
+      return _img.open(_src) ? &_img : NULL;
+    }
+    void closeEntry(){
+      delete _pattern;
+      _pattern = NULL;
+      delete _src;
+      _src = NULL;
+      if(_file)
+        fclose(_file);
+      _file = NULL;
+    }
+  private:
+    uint16_t _leds;
+    PatternParams _params;
+    FILE* _file;
+    StdioSource* _src;
+    ImageSource _img;
+    Pattern* _pattern;
+};
+
+// NAME[:LINE_MS[:GAP_MS[:REPEAT]]],... into entries, the number of entries
+static int parsePlaylist(const char* list, PlaylistEntry* entries){
+  char buf[512];
+  int count = 0;
+
+  snprintf(buf, sizeof(buf), "%s", list);
+  for(char* item = strtok(buf, ","); item && count < PLAYLIST_MAX; item = strtok(NULL, ",")){
+    PlaylistEntry& entry = entries[count++];
+    unsigned line = 0, gap = 0, repeat = 1;
+    char* colon = strchr(item, ':');
+    if(colon){
+      *colon = 0;
+      sscanf(colon + 1, "%u:%u:%u", &line, &gap, &repeat);
+    }
+    memset(&entry, 0, sizeof(entry));
+    snprintf(entry.name, sizeof(entry.name), "%s", item);
+    entry.line_time = line;
+    entry.gap = gap;
+    entry.repeat = repeat;
+  }
+  return count;
+}
+
+
+int main(int argc, char** argv){
+  uint16_t leds = 60;
+  uint32_t line_us = 20000;
+  uint8_t slots = ROW_RING_SLOTS;
+  uint32_t web_us = 0;
+  uint32_t long_us = 0, long_every = 50;
+  bool long_allow = false;
+  uint8_t stretch = 1;
+  bool interpolate = true;
+  ResampleMode resample = RESAMPLE_BOX;
+  static const char* const resample_names[] = { "off", "nearest", "bilinear", "box" };
+  int iterations = 1;
+  const char* outname = NULL;
+  const char* inname = NULL;
+  const char* pattern = NULL;
+  PatternParams params = { 0xFFFFFF, 0x000000, 60, 10, "LED Painter" };
+  PlaylistEntry entries[PLAYLIST_MAX];
+  int entry_count = 0;
+  uint32_t gen_width = 0, gen_rows = 0;
+  StripSegment segments[SEGMENTS_MAX];
+  int8_t segment_count = 0;
+  int opt;
+
+  for(int arg = 1; arg < argc; arg++){
+    if(argv[arg][0] != '-' || argv[arg][1] == 0 || argv[arg][2] != 0){
+      inname = argv[arg];
+      continue;
+    }
+    opt = argv[arg][1];
+    if(opt == 'a'){
+      long_allow = true;
+      continue;
+    }
+    if(arg + 1 >= argc){
+      fprintf(stderr, "-%c needs a value\n", opt);
+      return 2;
+    }
+    const char* val = argv[++arg];
+    switch(opt){
+      case 's': if(sscanf(val, "%ux%u", &gen_width, &gen_rows) != 2) gen_width = 0; break;
+      case 'n': leds = atoi(val); break;
+      case 't': line_us = (uint32_t)(atof(val) * 1000); break;
+      case 'r': slots = atoi(val); break;
+      case 'k': stretch = atoi(val); break;
+      case 'm': interpolate = strcmp(val, "repeat") != 0; break;
+      case 'f':
+        for(int m = RESAMPLE_OFF; m <= RESAMPLE_BOX; m++)
+          if(!strcmp(val, resample_names[m])) resample = (ResampleMode)m;
+        break;
+      case 'w': web_us = atoi(val); break;
+      case 'j': long_us = atoi(val); break;
+      case 'e': long_every = atoi(val); break;
+      case 'o': outname = val; break;
+      case 'i': iterations = atoi(val); break;
+      case 'p': pattern = val; break;
+      case 'l': entry_count = parsePlaylist(val, entries); break;
+      case 'x': snprintf(params.text, sizeof(params.text), "%s", val); break;
+      case 'g':
+        if((segment_count = parseSegments(val, segments, SEGMENTS_MAX)) <= 0){
+          fprintf(stderr, "Segments not valid: %s\n", val);
+          return 2;
+        }
+        break;
+      default: inname = NULL; gen_width = 0; arg = argc; break;
+    }
+  }
+  if((!inname && !gen_width && !pattern && !entry_count) || iterations < 1 || long_every == 0){
+    fprintf(stderr, "Usage: %s [-n leds] [-t line_ms] [-r slots] [-k stretch] [-m repeat|blend] [-f resample] [-w web_us] [-j long_us] [-e rows] [-a] [-o frames.raw] [-i n] [-g segments] image.bmp|image.lpf|-s WxR|-p pattern|-l list [-x text]\n", argv[0]);
+    return 2;
+  }
+
+  //the whole file goes into RAM, the reads then measure the pipeline and not the disk
+  uint8_t* data = NULL;
+  size_t len = 0;
+  if(entry_count){
+    //the entries are opened from their files while drawing
+  }
+  else if(pattern){
+    Pattern* p = createPattern(pattern);
+    if(!p){
+      fprintf(stderr, "No pattern %s\n", pattern);
+      return 2;
+    }
+    delete p;
+  }
+  else if(gen_width){
+    data = makeBmp(gen_width, gen_rows, &len);
+  }
+  else{
+    FILE* in = fopen(inname, "rb");
+    if(!in){
+      perror(inname);
+      return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    len = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    data = (uint8_t*)malloc(len);
+    if(data && fread(data, 1, len, in) != len){
+      free(data);
+      data = NULL;
+    }
+    fclose(in);
+  }
+  if(!data && !pattern && !entry_count){
+    fprintf(stderr, "Can't load the image\n");
+    return 1;
+  }
+
+  ParallelEncoder encoder;
+  if(segment_count > 0 && !encoder.begin(segments, segment_count, leds)){
+    fprintf(stderr, "Segments share a pin or are outside of %u LEDs\n", (unsigned)leds);
+    return 2;
+  }
+
+  FILE* out = NULL;
+  if(outname && !(out = fopen(outname, "wb"))){
+    perror(outname);
+    return 1;
+  }
+
+  ColorLut lut;
+  lut.build(280, 255, 255, 255, 255, false);
+  LineScheduler scheduler(simClock, simWait);
+  RowPipeline pipeline(scheduler, lut);
+  pipeline.setStretch(stretch, interpolate);
+  pipeline.setResample(resample);
+  uint64_t best_work = 0;
+  char report[2048] = "";
+  int n;
+  int result = 0;
+
+  for(int it = 0; it < iterations; it++){
+    MemorySource mem;
+    mem.set(data, len);
+    CountingSource src(mem);
+    ImageSource img;
+    Pattern* gen = pattern ? createPattern(pattern) : NULL;
+    FileOpener opener(leds, params);
+    PlaylistSource list;
+    if(entry_count){
+      if(!list.begin(entries, entry_count, line_us, leds, resample, opener)){
+        fprintf(stderr, "A playlist entry can't be drawn\n");
+        result = 1;
+        break;
+      }
+    }
+    else if(gen){
+      gen->begin(leds, 500, line_us, params);
+    }
+    else if(!img.open(&src)){
+      fprintf(stderr, "Not a supported image\n");
+      result = 1;
+      break;
+    }
+    TimedSource timed(entry_count ? (RowSource&)list : gen ? (RowSource&)*gen : (RowSource&)img);
+    RecordingOutput strip(it == 0 ? out : NULL);
+    strip.begin(leds, 0);
+    if(segment_count > 0)
+      strip.setEncoder(&encoder, segments, segment_count);
+
+    uint32_t long_due = long_every, long_served = 0, long_refused = 0;
+    real_start = realMicros();
+    waited = 0;
+    if(!pipeline.begin(&timed, slots, leds)){
+      fprintf(stderr, "Image is %u wide, more than %u LEDs, and scaling is %s\n", (unsigned)timed.width(), (unsigned)leds,
+              resample == RESAMPLE_OFF ? "off" : "out of memory");
+      result = 1;
+      break;
+    }
+    while(pipeline.preload())
+      ;
+    uint32_t preload_us = simClock();
+    pipeline.start(&strip, entry_count ? list.linePeriod(0) : line_us);
+    //this is loop(): the pipeline, then the web server while there is time for it
+    while(pipeline.service()){
+      if(pipeline.canService()){
+        waited += web_us;
+        //a long request comes in every long_every rows, the sketch answers it
+        //with a 503 while drawing, which costs no more than a short one
+        if(long_us && strip.shows >= long_due){
+          long_due += long_every;
+          if(long_allow){
+            waited += long_us;
+            long_served++;
+          }
+          else
+            long_refused++;
+        }
+        int32_t idle = scheduler.untilNextLine() - LINE_SERVICE_US;
+        if(idle > 0)
+          simWait(idle);
+      }
+    }
+    bool direct = pipeline.direct();
+    bool scaled = pipeline.scaled();
+    pipeline.end();
+    uint64_t work = realMicros() - real_start;
+    uint16_t width = timed.width();
+    uint32_t rows = timed.rows();
+    delete gen;
+    //only the fastest run is reported, the others were disturbed by the PC
+    if(it > 0 && work >= best_work)
+      continue;
+    best_work = work;
+    n = 0;
+    const LineScheduler::Stats& stats = scheduler.stats();
+    n += snprintf(report + n, sizeof(report) - n, "Image:     %u x %u %s, %s%s\n", (unsigned)width, (unsigned)rows,
+                         entry_count ? "playlist" : pattern ? pattern : img.type() == IMAGE_LPF ? "LPF" : "BMP", direct ? "direct" : "ring", scaled ? ", scaled" : "");
+    n += snprintf(report + n, sizeof(report) - n, "Shown:     %u lines in %.3f s simulated, line time %.3f ms\n", (unsigned)strip.shows,
+                         (strip.last - strip.first) / 1e6, line_us / 1e3);
+    n += snprintf(report + n, sizeof(report) - n, "Work:      %llu us total, %.2f us per row, %.0f rows/s, preload %u us\n",
+                         (unsigned long long)work, rows ? (double)work / rows : 0.0,
+                         work ? rows * 1e6 / work : 0.0, (unsigned)preload_us);
+    n += snprintf(report + n, sizeof(report) - n, "Row read:  %.2f us avg, %u us max\n",
+                  rows ? (double)timed.total / rows : 0.0, (unsigned)timed.max);
+    n += snprintf(report + n, sizeof(report) - n, "Reads:     %u bytes in %u reads, %u seeks\n", (unsigned)src.bytes, (unsigned)src.reads, (unsigned)src.seeks);
+    if(strip.shows > 1)
+      n += snprintf(report + n, sizeof(report) - n, "Row gap:   %u..%u us\n", (unsigned)strip.min_gap, (unsigned)strip.max_gap);
+    if(strip.max_black)
+      n += snprintf(report + n, sizeof(report) - n, "Dark:      %.3f s longest run of black rows\n", strip.max_black / 1e6);
+    if(segment_count > 0)
+      n += snprintf(report + n, sizeof(report) - n, "Strips:    %d, longest %u LEDs, %u us on the wire per row instead of %u us, encode %.2f us avg, %u errors\n",
+                    (int)segment_count, (unsigned)encoder.longest(), (unsigned)(encoder.bits() * WS_BIT_NS / 1000),
+                    (unsigned)((uint32_t)leds * 24 * WS_BIT_NS / 1000), strip.shows ? (double)strip.encode_us / strip.shows : 0.0,
+                    (unsigned)strip.errors);
+    if(long_us)
+      n += snprintf(report + n, sizeof(report) - n, "Requests:  %u long requests of %u us served, %u refused with 503\n",
+                    (unsigned)long_served, (unsigned)long_us, (unsigned)long_refused);
+    if(stats.lines)
+      n += snprintf(report + n, sizeof(report) - n, "Lines:     %u late %u max late %u us avg late %u us resyncs %u\n", (unsigned)stats.lines,
+                           (unsigned)stats.late_lines, (unsigned)stats.max_late_us, (unsigned)(stats.total_late_us / stats.lines),
+                           (unsigned)stats.resyncs);
+  }
+
+  fputs(report, stdout);
+
+  free(data);
+  if(out && fclose(out) != 0)
+    result = 1;
+  return result;
+}
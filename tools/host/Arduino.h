@@ -0,0 +1,85 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Just enough of the ESP8266 Arduino core to build the page code on the PC
+// (see tools/pagesim.cpp). Print writes numbers from the stack and String
+// grows with realloc to the length it needs, like the core 2.3.0 ones.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+class __FlashStringHelper;
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper*>(p))
+#define F(s) FPSTR(s)
+
+class String {
+  public:
+    String(const char* s = "") : _buf(NULL), _len(0) { concat(s, strlen(s)); }
+    String(const String& s) : _buf(NULL), _len(0) { concat(s.c_str(), s.length()); }
+    ~String() { free(_buf); }
+    String& operator=(const String& s) { if(this != &s){ _len = 0; concat(s.c_str(), s.length()); } return *this; }
+    String& operator+=(const String& s) { concat(s.c_str(), s.length()); return *this; }
+    String& operator+=(const char* s) { concat(s, strlen(s)); return *this; }
+    String& operator+=(const __FlashStringHelper* s) { return *this += (const char*)s; }
+    String& operator+=(char c) { concat(&c, 1); return *this; }
+    String& operator+=(unsigned long v) { char b[12]; snprintf(b, sizeof(b), "%lu", v); return *this += b; }
+    bool concat(const char* s, size_t n){
+      char* b = (char*)realloc(_buf, _len + n + 1);
+      if(!b)
+        return false;
+      _buf = b;
+      memcpy(_buf + _len, s, n);
+      _len += n;
+      _buf[_len] = 0;
+      return true;
+    }
+    const char* c_str() const { return _buf ? _buf : ""; }
+    unsigned int length() const { return _len; }
+  private:
+    char* _buf;
+    size_t _len;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len){
+      size_t n = 0;
+      while(len--)
+        n += write(*buf++);
+      return n;
+    }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+    size_t print(const __FlashStringHelper* s) { return write((const char*)s); }   // flash is RAM on the PC
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return number("%ld", v); }
+    size_t print(unsigned int v) { return number("%lu", v); }
+    size_t print(long v) { return number("%ld", v); }
+    size_t print(unsigned long v) { return number("%lu", v); }
+    size_t print(double v, int digits = 2){
+      char b[32];
+      snprintf(b, sizeof(b), "%.*f", digits, v);
+      return write(b);
+    }
+    template<class T> size_t println(const T& v) { size_t n = print(v); return n + write("\r\n"); }
+
+  private:
+    size_t number(const char* format, long v){
+      char b[24];
+      snprintf(b, sizeof(b), format, v);
+      return write(b);
+    }
+};
+
+#endif
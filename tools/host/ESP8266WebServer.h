@@ -0,0 +1,50 @@
+#ifndef HOST_ESP8266_WEB_SERVER_H
+#define HOST_ESP8266_WEB_SERVER_H
+
+// The part of ESP8266WebServer the page code uses, for tools/pagesim.cpp.
+// Nothing goes out, the server counts the bytes of a response and hashes
+// them so two ways of sending a page can be compared.
+
+#include "Arduino.h"
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+
+class ESP8266WebServer;
+
+class WiFiClient {
+  public:
+    WiFiClient() : _server(NULL) {}
+    WiFiClient(ESP8266WebServer* server) : _server(server) {}
+    size_t write(const uint8_t* buf, size_t len);
+  private:
+    ESP8266WebServer* _server;
+};
+
+class ESP8266WebServer {
+  public:
+    ESP8266WebServer() : sent(0), hash(2166136261u), _length(CONTENT_LENGTH_UNKNOWN) {}
+    void setContentLength(size_t len) { _length = len; }
+    // the header is left out, only the content is counted
+    void send(int code, const char* content_type, const String& content) { (void)code; (void)content_type; sendContent(content); }
+    void sendContent(const String& content) { add((const uint8_t*)content.c_str(), content.length()); }
+    WiFiClient client() { return WiFiClient(this); }
+
+    void add(const uint8_t* buf, size_t len){
+      sent += len;
+      while(len--)
+        hash = (hash ^ *buf++) * 16777619u;    // FNV-1a
+    }
+    size_t sent;
+    uint32_t hash;
+  private:
+    size_t _length;
+};
+
+inline size_t WiFiClient::write(const uint8_t* buf, size_t len){
+  if(!_server)
+    return 0;
+  _server->add(buf, len);
+  return len;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef HOST_HEAP_COUNTER_H
+#define HOST_HEAP_COUNTER_H
+
+// Counts the heap on the PC by replacing malloc and free (see
+// tools/pagesim.cpp and tools/thumbsim.cpp). Only blocks allocated while
+// counting are followed, so what was there before doesn't disturb it.
+// Include it from the one file of a tool that has main(), it defines malloc.
+
+#include <stddef.h>
+#include <string.h>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void __libc_free(void* p);
+
+#define TRACKED_MAX 64
+static bool counting;
+static void* tracked[TRACKED_MAX];
+static size_t tracked_size[TRACKED_MAX];
+static size_t heap_now, heap_peak;
+static bool heap_lost;              // more blocks than TRACKED_MAX
+
+static void track(void* p, size_t size){
+  if(!counting || !p)
+    return;
+  for(int i = 0; i < TRACKED_MAX; i++){
+    if(!tracked[i]){
+      tracked[i] = p;
+      tracked_size[i] = size;
+      heap_now += size;
+      if(heap_now > heap_peak)
+        heap_peak = heap_now;
+      return;
+    }
+  }
+  heap_lost = true;
+}
+
+static void untrack(void* p){
+  for(int i = 0; p && i < TRACKED_MAX; i++){
+    if(tracked[i] == p){
+      tracked[i] = NULL;
+      heap_now -= tracked_size[i];
+      return;
+    }
+  }
+}
+
+extern "C" void* malloc(size_t size){
+  void* p = __libc_malloc(size);
+  track(p, size);
+  return p;
+}
+
+extern "C" void* calloc(size_t n, size_t size){
+  void* p = __libc_calloc(n, size);
+  track(p, n * size);
+  return p;
+}
+
+extern "C" void* realloc(void* old, size_t size){
+  untrack(old);
+  void* p = __libc_realloc(old, size);
+  track(p, size);
+  return p;
+}
+
+extern "C" void free(void* p){
+  untrack(p);
+  __libc_free(p);
+}
+
+// counts from now on, until counting is set to false
+static void startCounting(){
+  memset(tracked, 0, sizeof(tracked));
+  heap_now = heap_peak = 0;
+  heap_lost = false;
+  counting = true;
+}
+
+#endif
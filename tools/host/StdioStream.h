@@ -0,0 +1,27 @@
+#ifndef HOST_STDIO_STREAM_H
+#define HOST_STDIO_STREAM_H
+
+#include <stdio.h>
+#include "ImageFormat.h"
+
+// ByteSource/ByteSink on top of a stdio FILE, the PC side of
+// src/SpiffsStream.h for the tools
+class StdioSource : public ByteSource {
+  public:
+    StdioSource(FILE* f) : _f(f) {}
+    size_t read(uint8_t* buf, size_t len) { return fread(buf, 1, len, _f); }
+    bool seek(uint32_t pos) { return fseek(_f, pos, SEEK_SET) == 0; }
+    uint32_t position() { return ftell(_f); }
+  private:
+    FILE* _f;
+};
+
+class StdioSink : public ByteSink {
+  public:
+    StdioSink(FILE* f) : _f(f) {}
+    size_t write(const uint8_t* buf, size_t len) { return fwrite(buf, 1, len, _f); }
+  private:
+    FILE* _f;
+};
+
+#endif
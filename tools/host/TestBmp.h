@@ -0,0 +1,31 @@
+#ifndef HOST_TEST_BMP_H
+#define HOST_TEST_BMP_H
+
+// A generated image for the tools which need one without a file (see
+// tools/convbench.cpp, tools/drawsim.cpp and tools/thumbsim.cpp).
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// 24 Bit bottom-up BMP with bands and a gradient, rows padded like a real
+// one. NULL if there is no memory, free() it after use
+static uint8_t* makeBmp(uint32_t width, uint32_t rows, size_t* len){
+  uint32_t stride = (width * 3 + 3) & ~3;
+  *len = 54 + stride * rows;
+  uint8_t* bmp = (uint8_t*)calloc(*len, 1);
+  if(!bmp)
+    return NULL;
+  uint32_t fields[][2] = { {2, (uint32_t)*len}, {10, 54}, {14, 40}, {18, width}, {22, rows}, {26, 1 | (24 << 16)}, {34, stride * rows} };
+  bmp[0] = 'B'; bmp[1] = 'M';
+  for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    for(int b = 0; b < 4; b++)
+      bmp[fields[i][0] + b] = fields[i][1] >> (8 * b);
+  for(uint32_t y = 0; y < rows; y++)
+    for(uint32_t x = 0; x < width; x++){
+      uint8_t* p = bmp + 54 + y * stride + x * 3;
+      p[0] = (x / 8) & 1 ? 255 : 0; p[1] = y * 255 / rows; p[2] = x * 255 / width;
+    }
+  return bmp;
+}
+
+#endif
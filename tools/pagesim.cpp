@@ -0,0 +1,159 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Checks the heap a streamed page takes on the PC: a file list of 0 to
+// several thousand entries is sent once with the PageWriter and once built
+// in a String first, the way the pages were made before. The heap is counted
+// while a page is made. With the PageWriter the peak must not depend on the
+// number of entries, and both ways must send the same bytes. The Arduino
+// parts come from the stand-ins in tools/host. Build with:
+//   g++ -O2 -Itools/host -Isrc -o pagesim tools/pagesim.cpp src/PageWriter.cpp
+// Usage: pagesim [-n ENTRIES]
+//   -n N  check an empty list and one of N entries instead of the built in set
+// The exit code is 1 if the PageWriter peak grows with the list or the pages
+// differ.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PageWriter.h"
+#include "LED_Painter.h"
+#include "host/HeapCounter.h"
+
+// Print into a String, every print() is one += like the old handlers
+class StringPrint : public Print {
+  public:
+    StringPrint(String& s) : _s(s) {}
+    size_t write(uint8_t c) { _s += (char)c; return 1; }
+    size_t write(const uint8_t* buf, size_t len) { return _s.concat((const char*)buf, len) ? len : 0; }
+    using Print::write;
+  private:
+    String& _s;
+};
+
+// the body of the image list, like handleFileList()
+static void printList(Print& out, uint32_t entries){
+  char name[32];
+
+  out.print(FPSTR(HTTP_HEAD_END));
+  out.print(F("<form action=\"/config\" method=\"get\">"));
+  out.print(F("<select name=\"image\" size=\"10\" onchange=\"setImage(this)\">"));
+  for(uint32_t i = 0; i < entries; i++){
+    snprintf(name, sizeof(name), "/image%04u.bmp", (unsigned)i);
+    out.print(F("<option value=\""));
+    out.print(name);
+    out.print(F("\">"));
+    out.print(name + 1);
+    out.print(F(" ("));
+    out.print(144u);
+    out.print(F(" LEDs, "));
+    out.print(i * 7 % 2000);
+    out.print(F(" rows, "));
+    out.print(i * 7 % 2000 * 0.015, 1);
+    out.print(F(" s)</option>"));
+  }
+  out.print(F("</select><br/><input type=\"submit\" value=\"Select\"></form></div></body></html>"));
+}
+
+struct Result {
+  size_t peak;
+  size_t sent;
+  uint32_t hash;
+};
+
+static Result streamed(uint32_t entries){
+  ESP8266WebServer server;
+  Result r;
+
+  startCounting();
+  {
+    PageWriter page(server);
+    page.begin("List Images");
+    printList(page, entries);
+    page.end();
+  }
+  counting = false;
+  r.peak = heap_peak;
+  r.sent = server.sent;
+  r.hash = server.hash;
+  return r;
+}
+
+static Result buffered(uint32_t entries){
+  ESP8266WebServer server;
+  Result r;
+
+  startCounting();
+  {
+    String page;
+    StringPrint out(page);
+    char c;
+    //the head with the title put in, then the rest
+    for(PGM_P p = HTTP_HEAD; (c = pgm_read_byte(p)) != 0; p++){
+      if(c == '{' && !strncmp(p, "{v}", 3)){
+        out.print("List Images");
+        p += 2;
+        continue;
+      }
+      out.print(c);
+    }
+    printList(out, entries);
+    server.send(200, "text/html", page);
+  }
+  counting = false;
+  r.peak = heap_peak;
+  r.sent = server.sent;
+  r.hash = server.hash;
+  return r;
+}
+
+int main(int argc, char** argv){
+  static const uint32_t sizes[] = { 0, 10, 100, 1000, 5000 };
+  uint32_t custom[2] = { 0, 0 };
+  const uint32_t* list = sizes;
+  size_t count = sizeof(sizes) / sizeof(sizes[0]);
+  size_t first_peak = 0;
+  int failed = 0;
+
+  for(int i = 1; i < argc; i++){
+    if(!strcmp(argv[i], "-n") && i + 1 < argc){
+      custom[1] = atoi(argv[++i]);
+      list = custom;
+      count = 2;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s [-n entries]\n", argv[0]);
+    return 2;
+  }
+  printf("Entries     Page bytes   PageWriter peak   String peak\n");
+  for(size_t i = 0; i < count; i++){
+    Result s = streamed(list[i]);
+    Result b = buffered(list[i]);
+    bool same = s.sent == b.sent && s.hash == b.hash;
+    if(i == 0)
+      first_peak = s.peak;
+    printf("%7u %14u %17u %13u%s%s%s\n", (unsigned)list[i], (unsigned)s.sent, (unsigned)s.peak, (unsigned)b.peak,
+           same ? "" : "  pages differ", s.peak != first_peak ? "  peak grows" : "", heap_lost ? "  too many blocks" : "");
+    failed += !same || s.peak != first_peak || heap_lost;
+  }
+  return failed ? 1 : 0;
+}
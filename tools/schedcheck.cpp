@@ -0,0 +1,224 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Checks the LineScheduler on the PC with a fake clock: the clock only
+// moves when the scheduler waits or a line "works", so every edge time is
+// exact. The cases are lines on time, a late line which the next ones catch
+// up, a line more than a whole period late which restarts the schedule, the
+// 32 Bit micros() overflow, a wait that returns early and a new period in
+// the middle of a draw. Build with:
+//   g++ -O2 -Wall -Isrc -o schedcheck tools/schedcheck.cpp src/LineScheduler.cpp
+// Usage: schedcheck
+// The exit code is 1 if an edge or a statistic is wrong.
+
+#include <stdio.h>
+#include <string.h>
+#include "LineScheduler.h"
+
+#define PERIOD 1000
+
+static uint32_t fake_now;
+static uint32_t wait_max;           // a wait sleeps at most this long, 0 for as long as asked
+static uint32_t waits;
+
+static uint32_t fakeClock(){
+  return fake_now;
+}
+
+static void fakeWait(uint32_t us){
+  waits++;
+  fake_now += wait_max && us > wait_max ? wait_max : us;
+}
+
+static int failed;
+static const char* current;
+
+static void expect(bool ok, const char* what, uint32_t got, uint32_t want){
+  if(ok)
+    return;
+  printf("%s: %s is %u instead of %u\n", current, what, (unsigned)got, (unsigned)want);
+  failed++;
+}
+
+#define EXPECT_EQ(what, got, want) expect((got) == (want), what, got, want)
+
+// runs lines with work[i] us of work after edge i, edges[] gets the edge times
+// relative to start() and late[] what waitForLine() returned
+static void run(LineScheduler& s, const uint32_t* work, int lines, uint32_t* edges, uint32_t* late){
+  uint32_t start = fake_now;
+  s.start(PERIOD);
+  for(int i = 0; i < lines; i++){
+    late[i] = s.waitForLine();
+    edges[i] = fake_now - start;
+    fake_now += work[i];
+  }
+}
+
+static void onTime(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t work[10], edges[10], late[10];
+
+  current = "on time";
+  for(int i = 0; i < 10; i++)
+    work[i] = 100 + i * 80;           // row costs up to just below the period
+  run(s, work, 10, edges, late);
+  for(int i = 0; i < 10; i++){
+    EXPECT_EQ("edge", edges[i], (uint32_t)(i * PERIOD));
+    EXPECT_EQ("lateness", late[i], 0u);
+  }
+  EXPECT_EQ("lines", s.stats().lines, 10u);
+  EXPECT_EQ("late lines", s.stats().late_lines, 0u);
+  EXPECT_EQ("resyncs", s.stats().resyncs, 0u);
+}
+
+// a line overruns by 300us: the next edge is that late, the one after is
+// back on the grid because the lateness comes out of the next period
+static void catchUp(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t work[8] = { 200, 200, 1300, 200, 200, 1030, 200, 200 };
+  uint32_t edges[8], late[8];
+
+  current = "catch up";
+  run(s, work, 8, edges, late);
+  uint32_t want_edges[8] = { 0, 1000, 2000, 3300, 4000, 5000, 6030, 7000 };
+  uint32_t want_late[8] =  { 0, 0, 0, 300, 0, 0, 30, 0 };
+  for(int i = 0; i < 8; i++){
+    EXPECT_EQ("edge", edges[i], want_edges[i]);
+    EXPECT_EQ("lateness", late[i], want_late[i]);
+  }
+  // 30us is within LINE_LATE_TOLERANCE_US, only the 300us line counts as late
+  EXPECT_EQ("late lines", s.stats().late_lines, 1u);
+  EXPECT_EQ("max late", s.stats().max_late_us, 300u);
+  EXPECT_EQ("total late", s.stats().total_late_us, 330u);
+  EXPECT_EQ("resyncs", s.stats().resyncs, 0u);
+}
+
+// a line takes 2.5 periods: the schedule restarts at the late edge instead of
+// showing the missed lines in a burst, no gap after it is shorter than a period
+static void resync(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t work[8] = { 200, 2500, 200, 200, 1799, 200, 200, 200 };
+  uint32_t edges[8], late[8];
+
+  current = "resync";
+  run(s, work, 8, edges, late);
+  uint32_t want_edges[8] = { 0, 1000, 3500, 4500, 5500, 7299, 7500, 8500 };
+  uint32_t want_late[8] =  { 0, 0, 1500, 0, 0, 799, 0, 0 };
+  for(int i = 0; i < 8; i++){
+    EXPECT_EQ("edge", edges[i], want_edges[i]);
+    EXPECT_EQ("lateness", late[i], want_late[i]);
+  }
+  // 799us late is caught up, the line after it is short
+  EXPECT_EQ("resyncs", s.stats().resyncs, 1u);
+  EXPECT_EQ("late lines", s.stats().late_lines, 2u);
+  EXPECT_EQ("max late", s.stats().max_late_us, 1500u);
+}
+
+// exactly one period late is a missed line and restarts the schedule as well
+static void wholePeriod(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t work[4] = { 2000, 200, 200, 200 };
+  uint32_t edges[4], late[4];
+
+  current = "whole period";
+  run(s, work, 4, edges, late);
+  uint32_t want_edges[4] = { 0, 2000, 3000, 4000 };
+  for(int i = 0; i < 4; i++)
+    EXPECT_EQ("edge", edges[i], want_edges[i]);
+  EXPECT_EQ("lateness", late[1], (uint32_t)PERIOD);
+  EXPECT_EQ("resyncs", s.stats().resyncs, 1u);
+}
+
+// micros() wraps after ~71 minutes, the edges must go on across it
+static void overflow(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t work[10], edges[10], late[10];
+
+  current = "overflow";
+  fake_now = 0xFFFFFFFFu - 3500;
+  for(int i = 0; i < 10; i++)
+    work[i] = i == 4 ? 1200 : 300;
+  run(s, work, 10, edges, late);
+  for(int i = 0; i < 10; i++)
+    EXPECT_EQ("edge", edges[i], (uint32_t)(i * PERIOD + (i == 5 ? 200 : 0)));
+  EXPECT_EQ("resyncs", s.stats().resyncs, 0u);
+  EXPECT_EQ("max late", s.stats().max_late_us, 200u);
+}
+
+// delay() may come back early (e.g. from a yield), the scheduler waits again
+static void shortWaits(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t work[6] = { 100, 100, 100, 100, 100, 100 };
+  uint32_t edges[6], late[6];
+
+  current = "short waits";
+  wait_max = 70;
+  waits = 0;
+  run(s, work, 6, edges, late);
+  wait_max = 0;
+  for(int i = 0; i < 6; i++){
+    EXPECT_EQ("edge", edges[i], (uint32_t)(i * PERIOD));
+    EXPECT_EQ("lateness", late[i], 0u);
+  }
+  // 900us left per line in steps of 70us
+  EXPECT_EQ("waits", waits, 5u * 13u);
+}
+
+// a new line time counts from the last edge
+static void newPeriod(){
+  LineScheduler s(fakeClock, fakeWait);
+  uint32_t edges[6];
+  uint32_t start = fake_now;
+
+  current = "new period";
+  s.start(PERIOD);
+  for(int i = 0; i < 6; i++){
+    s.waitForLine();
+    edges[i] = fake_now - start;
+    fake_now += 100;
+    if(i == 2)
+      s.setPeriod(400);
+    if(i == 4)
+      s.setPeriod(2000);
+  }
+  uint32_t want_edges[6] = { 0, 1000, 2000, 2400, 2800, 4800 };
+  for(int i = 0; i < 6; i++)
+    EXPECT_EQ("edge", edges[i], want_edges[i]);
+  EXPECT_EQ("period", s.period(), 2000u);
+  EXPECT_EQ("until next line", (uint32_t)s.untilNextLine(), 2000u - 100u);
+}
+
+int main(int argc, char** argv){
+  if(argc > 1){
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  onTime();
+  catchUp();
+  resync();
+  wholePeriod();
+  overflow();
+  shortWaits();
+  newPeriod();
+  printf("%d wrong\n", failed);
+  return failed ? 1 : 0;
+}
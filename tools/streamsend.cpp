@@ -0,0 +1,281 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Sends test frames to the stick as DDP, E1.31 or Art-Net, to try the live
+// stream without a lighting program. With -l the frames go to a receiver in
+// the same process instead (FrameStream on a UDP socket on localhost, the
+// strip is a buffer), which reports packets per second, dropped packets and
+// the time from sending the first packet of a frame to its show(). Build with:
+//   g++ -O2 -pthread -Isrc -o streamsend tools/streamsend.cpp src/FrameStream.cpp src/ColorLut.cpp
+// Usage: streamsend [options] [host]
+//   -m MODE ddp, e131 or artnet (default ddp)
+//   -n LEDS strip length (default 60)
+//   -u N    first universe (default 1)
+//   -f FPS  frames per second, 0 sends as fast as possible (default 40)
+//   -c N    frames to send (default 400)
+//   -l      loopback test, host is ignored
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <thread>
+#include <atomic>
+#include "FrameStream.h"
+
+#define MAX_FRAMES 100000
+
+static uint64_t nowMicros(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t clock32(){
+  return (uint32_t)nowMicros();
+}
+
+static void put16(uint8_t* p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+static void put32(uint8_t* p, uint32_t v) { put16(p, v >> 16); put16(p + 2, v); }
+
+// packet header for the pixels at byte offset, returns its length
+static size_t header(StreamProtocol mode, uint8_t* h, uint16_t universe, uint32_t offset, uint16_t len, uint8_t seq, bool last){
+  switch(mode){
+    case STREAM_DDP:
+      h[0] = 0x40 | (last ? 0x01 : 0);
+      h[1] = seq;
+      h[2] = 0x0B;          // RGB, 8 bit
+      h[3] = 1;
+      put32(h + 4, offset);
+      put16(h + 8, len);
+      return 10;
+    case STREAM_E131:
+      memset(h, 0, 126);
+      put16(h, 0x0010);
+      memcpy(h + 4, "ASC-E1.17", 9);
+      put16(h + 16, 0x7000 | (126 - 16 + len));
+      put32(h + 18, 0x00000004);
+      put16(h + 38, 0x7000 | (126 - 38 + len));
+      put32(h + 40, 0x00000002);
+      strcpy((char*)h + 44, "streamsend");
+      h[108] = 100;
+      h[111] = seq;
+      put16(h + 113, universe);
+      put16(h + 115, 0x7000 | (126 - 115 + len));
+      h[117] = 0x02;
+      h[118] = 0xA1;
+      put16(h + 121, 1);
+      put16(h + 123, len + 1);
+      return 126;
+    default:
+      memcpy(h, "Art-Net", 8);
+      h[8] = 0x00; h[9] = 0x50;
+      put16(h + 10, 14);
+      h[12] = seq;
+      h[13] = 0;
+      h[14] = universe & 0xFF;
+      h[15] = universe >> 8;
+      put16(h + 16, len);
+      return 18;
+  }
+}
+
+// one datagram at a time from a socket, like WiFiUDP
+class SocketSource : public PacketSource {
+  public:
+    SocketSource(int fd) : _fd(fd), _len(0), _pos(0) {}
+    int parsePacket() {
+      ssize_t n = recv(_fd, _buf, sizeof(_buf), MSG_DONTWAIT);
+      _len = n > 0 ? n : 0;
+      _pos = 0;
+      return _len;
+    }
+    size_t read(uint8_t* buf, size_t len) {
+      if(len > _len - _pos)
+        len = _len - _pos;
+      memcpy(buf, _buf + _pos, len);
+      _pos += len;
+      return len;
+    }
+  private:
+    int _fd;
+    uint8_t _buf[1500];
+    size_t _len, _pos;
+};
+
+static uint64_t sent_at[MAX_FRAMES];       // first packet of each frame
+static uint64_t shown_at[MAX_FRAMES];
+static std::atomic<uint32_t> shown;
+
+class BufferOutput : public StripOutput {
+  public:
+    bool begin(uint16_t leds, uint8_t pin) { _leds = leds; _buf = (uint8_t*)calloc(leds, 3); return _buf != NULL; }
+    void end() { free(_buf); }
+    uint8_t* pixels() { return _buf; }
+    void show() {
+      uint32_t n = shown;
+      if(n < MAX_FRAMES)
+        shown_at[n] = nowMicros();
+      shown = n + 1;
+    }
+  private:
+    uint8_t* _buf;
+};
+
+int main(int argc, char** argv){
+  StreamProtocol mode = STREAM_DDP;
+  uint16_t leds = 60;
+  uint16_t universe = 1;
+  uint32_t fps = 40;
+  uint32_t count = 400;
+  bool loopback = false;
+  const char* host = NULL;
+
+  for(int arg = 1; arg < argc; arg++){
+    if(argv[arg][0] != '-'){
+      host = argv[arg];
+      continue;
+    }
+    if(argv[arg][1] == 'l'){
+      loopback = true;
+      continue;
+    }
+    if(arg + 1 >= argc){
+      fprintf(stderr, "%s needs a value\n", argv[arg]);
+      return 2;
+    }
+    const char* val = argv[++arg];
+    switch(argv[arg - 1][1]){
+      case 'm': mode = !strcmp(val, "e131") ? STREAM_E131 : !strcmp(val, "artnet") ? STREAM_ARTNET : STREAM_DDP; break;
+      case 'n': leds = atoi(val); break;
+      case 'u': universe = atoi(val); break;
+      case 'f': fps = atoi(val); break;
+      case 'c': count = atoi(val); break;
+      default:
+        fprintf(stderr, "unknown option %s\n", argv[arg - 1]);
+        return 2;
+    }
+  }
+  if(count > MAX_FRAMES)
+    count = MAX_FRAMES;
+  if(!loopback && !host){
+    fprintf(stderr, "usage: streamsend [-m ddp|e131|artnet] [-n leds] [-u universe] [-f fps] [-c frames] [-l] [host]\n");
+    return 2;
+  }
+
+  int out = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_port = htons(FrameStream::port(mode));
+  if(loopback){
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+  else{
+    struct hostent* he = gethostbyname(host);
+    if(!he){
+      fprintf(stderr, "unknown host %s\n", host);
+      return 1;
+    }
+    memcpy(&to.sin_addr, he->h_addr, 4);
+  }
+
+  //receiver on localhost with the same FrameStream as the stick
+  int in = loopback ? socket(AF_INET, SOCK_DGRAM, 0) : -1;
+  std::atomic<bool> running(true);
+  std::thread receiver;
+  ColorLut lut;
+  BufferOutput strip;
+  SocketSource source(in);
+  FrameStream stream(lut, clock32);
+  if(loopback){
+    int size = 1 << 20;
+    setsockopt(in, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    if(bind(in, (struct sockaddr*)&to, sizeof(to)) != 0){
+      perror("bind");
+      return 1;
+    }
+    lut.build(280, 255, 255, 255, 255, false);
+    strip.begin(leds, 0);
+    stream.begin(&source, mode, universe, &strip, leds);
+    receiver = std::thread([&](){
+      while(running)
+        if(!stream.poll(32))
+          usleep(50);
+      while(stream.poll(32))
+        ;
+    });
+  }
+
+  //pixels per packet: DDP up to 480, DMX one universe of 170
+  uint32_t bytes = leds * 3;
+  uint32_t chunk = mode == STREAM_DDP ? 1440 : STREAM_UNIVERSE_BYTES;
+  uint8_t packet[1600];
+  uint32_t packets = 0;
+  uint64_t start = nowMicros();
+  for(uint32_t f = 0; f < count; f++){
+    uint64_t due = start + (fps ? (uint64_t)f * 1000000 / fps : 0);
+    while(nowMicros() < due)
+      usleep(100);
+    sent_at[f] = nowMicros();
+    for(uint32_t off = 0, u = 0; off < bytes; off += chunk, u++){
+      uint16_t len = bytes - off < chunk ? bytes - off : chunk;
+      //DDP counts packets 1..15, Art-Net frames 1..255, E1.31 frames 0..255
+      uint8_t seq = mode == STREAM_DDP ? packets % 15 + 1 : mode == STREAM_ARTNET ? f % 255 + 1 : f;
+      size_t h = header(mode, packet, universe + u, off, len, seq, off + len >= bytes);
+      for(uint16_t i = 0; i < len; i++)
+        packet[h + i] = (f + off + i) & 0xFF;
+      sendto(out, packet, h + len, 0, (struct sockaddr*)&to, sizeof(to));
+      packets++;
+    }
+  }
+  double secs = (nowMicros() - start) / 1e6;
+  printf("sent %u frames in %u packets, %.0f packets/s\n", count, packets, packets / secs);
+
+  if(loopback){
+    usleep(200000);
+    running = false;
+    receiver.join();
+    const FrameStream::Stats& stats = stream.stats();
+    uint64_t total = 0, max = 0;
+    uint32_t n = shown < count ? (uint32_t)shown : count;
+    for(uint32_t f = 0; f < n; f++){
+      uint64_t l = shown_at[f] - sent_at[f];
+      total += l;
+      if(l > max)
+        max = l;
+    }
+    printf("received %u packets, %u frames shown, %u dropped, %u out of order, %u invalid\n", stats.packets,
+           stats.frames, stats.dropped, stats.out_of_order, stats.invalid);
+    printf("send to show: %.1f us avg, %llu us max; receive to show %.1f us avg; jitter %u us max\n",
+           n ? (double)total / n : 0.0, (unsigned long long)max, stats.frames ? (double)stats.total_latency_us / stats.frames : 0.0,
+           stats.max_jitter_us);
+    strip.end();
+    close(in);
+  }
+  close(out);
+  return 0;
+}
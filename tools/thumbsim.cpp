@@ -0,0 +1,209 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Checks the upload thumbnails on the PC: every image is made into a
+// thumbnail like after an upload, read back with the image reader and
+// compared with a box filtered copy of the whole image. The heap is counted
+// while the thumbnail is made, it must stay within THUMB_RAM however big the
+// image is. Without files a set of generated images is checked. Build with:
+//   g++ -O2 -Isrc -o thumbsim tools/thumbsim.cpp src/Thumbnail.cpp src/ImageFormat.cpp
+// Usage: thumbsim [-o DIR] [-s WIDTHxROWS] [image.bmp|image.lpf ...]
+//   -s WxR  check a generated 24 Bit BMP of this size
+//   -o DIR  also write the thumbnails to DIR as name.tmb (e.g. for the data folder)
+// The exit code is 1 if a thumbnail is wrong or took too much RAM.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Thumbnail.h"
+#include "host/HeapCounter.h"
+#include "host/TestBmp.h"
+
+static uint8_t thumb_buf[16384];
+
+class BufferSink : public ByteSink {
+  public:
+    BufferSink() : len(0) {}
+    size_t write(const uint8_t* buf, size_t n){
+      if(n > sizeof(thumb_buf) - len)
+        n = sizeof(thumb_buf) - len;
+      memcpy(thumb_buf + len, buf, n);
+      len += n;
+      return n;
+    }
+    size_t len;
+};
+
+// makes and checks the thumbnail of one image, false if it failed
+static bool check(const char* name, const uint8_t* data, size_t len, const char* outdir){
+  MemorySource mem;
+  ImageSource img;
+  BufferSink sink;
+
+  mem.set(data, len);
+  if(!img.open(&mem)){
+    printf("%s: not a supported image\n", name);
+    return false;
+  }
+  uint16_t leds = img.width();
+  uint32_t rows = img.rows();
+
+  startCounting();
+  bool ok = writeThumbnail(img, sink);
+  counting = false;
+  if(!ok){
+    printf("%s: %ux%u, no thumbnail%s\n", name, (unsigned)leds, (unsigned)rows,
+           leds > THUMB_SRC_WIDTH_MAX ? " (too wide, as expected)" : "");
+    return leds > THUMB_SRC_WIDTH_MAX;
+  }
+
+  //read back, thumbnail row y is LED bin y, pixel x is row bin x
+  MemorySource tmem;
+  ImageSource thumb;
+  tmem.set(thumb_buf, sink.len);
+  if(!thumb.open(&tmem) || !thumb.indexed()){
+    printf("%s: thumbnail can't be read\n", name);
+    return false;
+  }
+  uint16_t tw = thumb.width();
+  uint32_t th = thumb.rows();
+  uint8_t* src_row = (uint8_t*)malloc(leds * 3);
+  uint8_t* thumb_row = (uint8_t*)malloc(tw * 3);
+  double* sums = (double*)calloc((size_t)tw * th * 4, sizeof(double));
+  for(uint32_t r = 0; r < rows; r++){
+    img.readRow(r, src_row);
+    uint32_t x = (uint64_t)r * tw / rows;
+    for(uint32_t i = 0; i < leds; i++){
+      double* s = sums + ((uint64_t)i * th / leds * tw + x) * 4;
+      for(int c = 0; c < 3; c++)
+        s[c] += src_row[i * 3 + c];
+      s[3]++;
+    }
+  }
+  //one step of the colour cube, half of it is the rounding
+  static const int tolerance[3] = { 255 / 6 / 2 + 1, 255 / 5 / 2 + 1, 255 / 5 / 2 + 1 };   // GRB
+  int max_err = 0;
+  bool colors_ok = true;
+  for(uint32_t y = 0; y < th; y++){
+    thumb.readRow(y, thumb_row);
+    for(uint32_t x = 0; x < tw; x++){
+      double* s = sums + (y * tw + x) * 4;
+      for(int c = 0; c < 3; c++){
+        int err = abs((int)thumb_row[x * 3 + c] - (int)(s[c] / s[3] + 0.5));
+        if(err > max_err)
+          max_err = err;
+        if(err > tolerance[c])
+          colors_ok = false;
+      }
+    }
+  }
+  free(sums);
+  free(thumb_row);
+  free(src_row);
+
+  bool ram_ok = !heap_lost && heap_peak <= THUMB_RAM;
+  printf("%s: %ux%u -> %ux%u, %u bytes (%u%% of 24 Bit), heap %u of %u, max error %d%s%s\n", name, (unsigned)leds,
+         (unsigned)rows, (unsigned)tw, (unsigned)th, (unsigned)sink.len,
+         (unsigned)(sink.len * 100 / (54 + ((tw * 3 + 3) & ~3) * th)), (unsigned)heap_peak, (unsigned)THUMB_RAM, max_err,
+         ram_ok ? "" : ", TOO MUCH RAM", colors_ok ? "" : ", WRONG COLOURS");
+
+  if(outdir){
+    char path[512];
+    const char* base = strrchr(name, '/');
+    snprintf(path, sizeof(path), "%s/%s", outdir, base ? base + 1 : name);
+    char* dot = strrchr(path, '.');
+    if(dot && dot > strrchr(path, '/'))
+      strcpy(dot, ".tmb");
+    FILE* f = fopen(path, "wb");
+    if(!f || fwrite(thumb_buf, 1, sink.len, f) != sink.len){
+      perror(path);
+      ram_ok = false;
+    }
+    if(f)
+      fclose(f);
+  }
+  return ram_ok && colors_ok;
+}
+
+static bool checkGenerated(uint32_t width, uint32_t rows, const char* outdir){
+  char name[32];
+  size_t len;
+  uint8_t* bmp = makeBmp(width, rows, &len);
+  if(!bmp)
+    return false;
+  snprintf(name, sizeof(name), "gen%ux%u.bmp", (unsigned)width, (unsigned)rows);
+  bool ok = check(name, bmp, len, outdir);
+  free(bmp);
+  return ok;
+}
+
+int main(int argc, char** argv){
+  const char* outdir = NULL;
+  bool ok = true;
+  int checked = 0;
+
+  for(int arg = 1; arg < argc; arg++){
+    if(!strcmp(argv[arg], "-o") && arg + 1 < argc){
+      outdir = argv[++arg];
+    }
+    else if(!strcmp(argv[arg], "-s") && arg + 1 < argc){
+      unsigned w, r;
+      if(sscanf(argv[++arg], "%ux%u", &w, &r) != 2 || !w || !r){
+        fprintf(stderr, "-s needs WIDTHxROWS\n");
+        return 2;
+      }
+      ok &= checkGenerated(w, r, outdir);
+      checked++;
+    }
+    else if(argv[arg][0] == '-'){
+      fprintf(stderr, "Usage: %s [-o dir] [-s WxR] [image.bmp|image.lpf ...]\n", argv[0]);
+      return 2;
+    }
+    else{
+      FILE* in = fopen(argv[arg], "rb");
+      if(!in){
+        perror(argv[arg]);
+        ok = false;
+        continue;
+      }
+      fseek(in, 0, SEEK_END);
+      size_t len = ftell(in);
+      fseek(in, 0, SEEK_SET);
+      uint8_t* data = (uint8_t*)malloc(len);
+      if(data && fread(data, 1, len, in) == len)
+        ok &= check(argv[arg], data, len, outdir);
+      else
+        ok = false;
+      free(data);
+      fclose(in);
+      checked++;
+    }
+  }
+  if(!checked){
+    //short and long strokes, small images, the widest strip
+    static const uint32_t sizes[][2] = { {60, 500}, {288, 2000}, {144, 30}, {1, 1}, {7, 3}, {64, 64}, {60, 100000},
+                                         {THUMB_SRC_WIDTH_MAX, 400}, {THUMB_SRC_WIDTH_MAX + 1, 10} };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+      ok &= checkGenerated(sizes[i][0], sizes[i][1], outdir);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Uploads a file into a simulated SPIFFS, once written chunk by chunk as it
+// arrives (like the web server used to) and once through the UploadWriter,
+// and compares the time the flash would take. The flash costs a fixed time
+// per write call (object index and header updates) and per page programmed,
+// a page which is only partly written is programmed again by the next write.
+// The result is checked against the CRC of the input, also for an upload
+// broken off and resumed at an offset. Build with:
+//   g++ -O2 -Isrc -o uploadsim tools/uploadsim.cpp src/UploadWriter.cpp src/Crc32.cpp
+// Usage: uploadsim [options]
+//   -s KB   file size (default 300)
+//   -c N    bytes per received chunk, 0 for random 1..2048 (default 0)
+//   -w US   flash time per write call (default 600)
+//   -p US   flash time per page programmed (default 120)
+//   -b N    break the upload off after N bytes and resume it (default size / 3)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "UploadWriter.h"
+#include "Crc32.h"
+
+static uint32_t call_us = 600;
+static uint32_t page_us = 120;
+
+// A file on the simulated flash, counts the flash time of the writes
+class FlashFile : public ByteSink {
+  public:
+    FlashFile(size_t capacity) : _data((uint8_t*)malloc(capacity)), _len(0), _capacity(capacity), _us(0), _calls(0) {}
+    ~FlashFile() { free(_data); }
+    size_t write(const uint8_t* buf, size_t len) {
+      if(_len + len > _capacity)
+        len = _capacity - _len;
+      //every page from the one holding the current end up to the new end
+      uint32_t pages = (_len + len + UPLOAD_PAGE - 1) / UPLOAD_PAGE - _len / UPLOAD_PAGE;
+      memcpy(_data + _len, buf, len);
+      _len += len;
+      _us += call_us + pages * page_us;
+      _calls++;
+      return len;
+    }
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _len; }
+    uint64_t us() const { return _us; }
+    uint32_t calls() const { return _calls; }
+  private:
+    uint8_t* _data;
+    size_t _len;
+    size_t _capacity;
+    uint64_t _us;
+    uint32_t _calls;
+};
+
+static uint64_t realMicros(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t chunkSize(size_t fixed, size_t left){
+  size_t n = fixed ? fixed : 1 + rand() % 2048;
+  return n < left ? n : left;
+}
+
+static void report(const char* name, const FlashFile& f, uint64_t cpu_us){
+  double s = f.us() / 1e6;
+  printf("%-10s %6u writes  flash %8.1f ms  %7.1f KB/s  cpu %6llu us\n", name, f.calls(), f.us() / 1000.0,
+         f.size() / 1024.0 / s, (unsigned long long)cpu_us);
+}
+
+int main(int argc, char** argv){
+  size_t size = 300 * 1024;
+  size_t chunk = 0;
+  long cut = -1;
+  int opt;
+
+  for(int arg = 1; arg + 1 < argc; arg += 2){
+    if(argv[arg][0] != '-'){
+      fprintf(stderr, "unknown argument %s\n", argv[arg]);
+      return 2;
+    }
+    opt = argv[arg][1];
+    const char* val = argv[arg + 1];
+    switch(opt){
+      case 's': size = atoi(val) * 1024; break;
+      case 'c': chunk = atoi(val); break;
+      case 'w': call_us = atoi(val); break;
+      case 'p': page_us = atoi(val); break;
+      case 'b': cut = atol(val); break;
+      default:
+        fprintf(stderr, "unknown option -%c\n", opt);
+        return 2;
+    }
+  }
+  if(cut < 0 || (size_t)cut > size)
+    cut = size / 3;
+
+  uint8_t* input = (uint8_t*)malloc(size);
+  srand(1);
+  for(size_t i = 0; i < size; i++)
+    input[i] = rand();
+  uint32_t expected = crc32(input, size);
+
+  //as before: every chunk straight to the file
+  FlashFile direct(size);
+  uint64_t start = realMicros();
+  for(size_t pos = 0, n; pos < size; pos += n){
+    n = chunkSize(chunk, size - pos);
+    direct.write(input + pos, n);
+  }
+  report("direct", direct, realMicros() - start);
+
+  //collected in the UploadWriter, broken off after cut bytes and resumed
+  FlashFile file(size);
+  UploadWriter writer;
+  uint32_t resume_size, resume_crc;
+  size_t pos = 0, n;
+  start = realMicros();
+  writer.begin(&file);
+  for(; pos < (size_t)cut; pos += n){
+    n = chunkSize(chunk, cut - pos);
+    writer.write(input + pos, n);
+  }
+  writer.flush();
+  resume_size = writer.written();
+  resume_crc = writer.crc();
+  writer.end();
+  writer.begin(&file, resume_size, resume_crc);
+  for(pos = resume_size; pos < size; pos += n){
+    n = chunkSize(chunk, size - pos);
+    writer.write(input + pos, n);
+  }
+  writer.flush();
+  uint64_t cpu = realMicros() - start;
+  report("buffered", file, cpu);
+
+  bool ok = writer.written() == size && writer.crc() == expected && file.size() == size &&
+            memcmp(file.data(), input, size) == 0;
+  printf("resumed at %u, crc %08x, %s\n", resume_size, writer.crc(), ok ? "ok" : "MISMATCH");
+  writer.end();
+  free(input);
+  return ok ? 0 : 1;
+}
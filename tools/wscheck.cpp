@@ -0,0 +1,136 @@
+/*
+ * LED-Lightpainter - A DIY Pixelstick clone for Lightpainting using the ESP8266 and a WS2812 Strip (Neopixel)
+ * 
+ * Copyright (C) 2018 Timmo Hellemann 
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+*/
+
+
+
+// Checks the UART encoding of the WS2812 bits on the PC: every pixel byte
+// value 0..255 is encoded with wsEncodeUart, the UART bytes are turned into
+// the line levels the inverted TX pin sends (start bit, 6 data bits LSB
+// first, stop bit, 312.5ns each) and the line is cut into WS2812 bits of
+// WS_BIT_NS. Each bit must be one high pulse followed by low, with the high
+// and low times of a 0 or a 1 within the datasheet tolerance, and the bits
+// must read back as the byte. Build with:
+//   g++ -O2 -Wall -Isrc -o wscheck tools/wscheck.cpp src/WsEncoder.cpp
+// Usage: wscheck [-v]
+//   -v  print the line levels of every byte value
+// The exit code is 1 if a byte value is sent wrong.
+
+#include <stdio.h>
+#include <string.h>
+#include "WsEncoder.h"
+
+#define UART_FRAME_BITS 8                     // start, 6 data, stop
+#define SLOT_PS (1000000000000ULL / WS_UART_BAUD)   // one UART bit in ps
+#define SLOTS_PER_BIT 4                       // UART bits per WS2812 bit
+#define WS_T0L_NS (WS_BIT_NS - WS_T0H_NS)     // 850ns
+#define WS_T1L_NS (WS_BIT_NS - WS_T1H_NS)     // 450ns
+#define WS_TOLERANCE_NS 150                   // datasheet +-150ns on every time
+
+// line levels (1 high) of len UART bytes sent 6N1 with inverted TX
+static int lineLevels(const uint8_t* uart, size_t len, uint8_t* levels){
+  int n = 0;
+  for(size_t i = 0; i < len; i++){
+    levels[n++] = 1;                          // start bit 0, inverted
+    for(int b = 0; b < 6; b++)
+      levels[n++] = !((uart[i] >> b) & 1);
+    levels[n++] = 0;                          // stop bit 1, inverted
+  }
+  return n;
+}
+
+static bool within(uint32_t ns, uint32_t want){
+  return ns + WS_TOLERANCE_NS >= want && ns <= want + WS_TOLERANCE_NS;
+}
+
+// checks the line for one pixel byte, false and a message if it is wrong
+static bool checkByte(uint8_t value, bool verbose, uint32_t* high_min, uint32_t* high_max){
+  uint8_t uart[WS_UART_BYTES_PER_BYTE];
+  uint8_t levels[WS_UART_BYTES_PER_BYTE * UART_FRAME_BITS];
+  int n;
+  uint8_t got = 0;
+
+  wsEncodeUart(&value, 1, uart);
+  n = lineLevels(uart, sizeof(uart), levels);
+  if(n != 8 * SLOTS_PER_BIT || SLOT_PS * SLOTS_PER_BIT != WS_BIT_NS * 1000ULL){
+    printf("0x%02x: %d UART bits of %lluns don't make 8 WS2812 bits\n", value, n, (unsigned long long)SLOT_PS / 1000);
+    return false;
+  }
+  if(verbose){
+    printf("0x%02x ", value);
+    for(int i = 0; i < n; i++)
+      printf("%s%c", i % SLOTS_PER_BIT ? "" : " ", levels[i] ? '#' : '_');
+    printf("\n");
+  }
+  for(int bit = 0; bit < 8; bit++){
+    const uint8_t* l = levels + bit * SLOTS_PER_BIT;
+    int high = 0;
+    // one high pulse at the start of the bit, then low to its end
+    while(high < SLOTS_PER_BIT && l[high])
+      high++;
+    for(int i = high; i < SLOTS_PER_BIT; i++){
+      if(l[i]){
+        printf("0x%02x: bit %d has a second high pulse\n", value, 7 - bit);
+        return false;
+      }
+    }
+    uint32_t high_ns = high * SLOT_PS / 1000;
+    uint32_t low_ns = (SLOTS_PER_BIT - high) * SLOT_PS / 1000;
+    bool one = (value >> (7 - bit)) & 1;
+    if(!within(high_ns, one ? WS_T1H_NS : WS_T0H_NS) || !within(low_ns, one ? WS_T1L_NS : WS_T0L_NS)){
+      printf("0x%02x: bit %d (%d) is %uns high %uns low, wants %uns/%uns +-%uns\n", value, 7 - bit, one,
+             (unsigned)high_ns, (unsigned)low_ns, one ? WS_T1H_NS : WS_T0H_NS, one ? WS_T1L_NS : WS_T0L_NS, WS_TOLERANCE_NS);
+      return false;
+    }
+    // the strip takes a bit as 1 if the line is still high in the middle
+    got = got << 1 | (high_ns * 2 > WS_BIT_NS);
+    if(high_ns < high_min[one])
+      high_min[one] = high_ns;
+    if(high_ns > high_max[one])
+      high_max[one] = high_ns;
+  }
+  if(got != value){
+    printf("0x%02x: reads back as 0x%02x\n", value, got);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv){
+  bool verbose = false;
+  uint32_t high_min[2] = { 0xFFFFFFFF, 0xFFFFFFFF }, high_max[2] = { 0, 0 };
+  int failed = 0;
+
+  for(int i = 1; i < argc; i++){
+    if(!strcmp(argv[i], "-v")){
+      verbose = true;
+      continue;
+    }
+    fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+    return 2;
+  }
+  for(int v = 0; v < 256; v++)
+    failed += !checkByte(v, verbose, high_min, high_max);
+  printf("UART:    %u Baud, %llu.%03lluns per bit, %uns per WS2812 bit\n", WS_UART_BAUD,
+         (unsigned long long)SLOT_PS / 1000, (unsigned long long)SLOT_PS % 1000, WS_BIT_NS);
+  printf("0 bits:  %u..%uns high, T0H %uns +-%uns\n", (unsigned)high_min[0], (unsigned)high_max[0], WS_T0H_NS, WS_TOLERANCE_NS);
+  printf("1 bits:  %u..%uns high, T1H %uns +-%uns\n", (unsigned)high_min[1], (unsigned)high_max[1], WS_T1H_NS, WS_TOLERANCE_NS);
+  printf("%d of 256 byte values wrong\n", failed);
+  return failed ? 1 : 0;
+}